@@ -0,0 +1,898 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "memory_manager.h"
+#include "common_defs.h"
+
+#include "gitdata.h"
+
+// Returns a monotonic timestamp in nanoseconds
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Measures mem_alloc latency as the number of live blocks grows.
+ * The pool is filled with `live_blocks` blocks of random sizes (16..271 bytes),
+ * after which `samples` further allocations are timed. With a list scan the
+ * per-call cost grows with the number of live blocks; with segregated free
+ * lists it should stay flat.
+ */
+void bench_alloc_latency_live_blocks(mem_backend_t backend, int live_blocks, int samples)
+{
+    size_t max_block = 272;
+    mem_init_ex(&(mem_config_t){.size = (size_t)(live_blocks + samples) * (max_block + 32), .backend = backend});
+
+    srand(42);
+    long long start = now_ns();
+    for (int i = 0; i < live_blocks; i++)
+    {
+        void *block = mem_alloc(16 + rand() % (max_block - 16));
+        my_assert(block != NULL);
+    }
+    long long fill_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < samples; i++)
+    {
+        void *block = mem_alloc(16 + rand() % (max_block - 16));
+        my_assert(block != NULL);
+    }
+    long long sample_ns = now_ns() - start;
+
+    mem_deinit();
+
+    printf_yellow("  live blocks: %8d  fill: %10.1f ms  mem_alloc: %8.1f ns/op\n",
+                  live_blocks, fill_ns / 1e6, (double)sample_ns / samples);
+}
+
+/*
+ * Measures mem_free latency as the number of live blocks grows.
+ * The pool is filled with `live_blocks` blocks, then `samples` randomly chosen
+ * blocks are freed and timed. Pointer lookup cost should not depend on how
+ * many blocks exist.
+ */
+void bench_free_latency_live_blocks(mem_backend_t backend, int live_blocks, int samples)
+{
+    size_t max_block = 272;
+    mem_init_ex(&(mem_config_t){.size = (size_t)live_blocks * (max_block + 32), .backend = backend});
+
+    void **blocks = malloc(live_blocks * sizeof(void *));
+    srand(42);
+    for (int i = 0; i < live_blocks; i++)
+    {
+        blocks[i] = mem_alloc(16 + rand() % (max_block - 16));
+        my_assert(blocks[i] != NULL);
+    }
+
+    // Shuffle the first `samples` entries so the frees hit random addresses
+    for (int i = 0; i < samples; i++)
+    {
+        int j = i + rand() % (live_blocks - i);
+        void *tmp = blocks[i];
+        blocks[i] = blocks[j];
+        blocks[j] = tmp;
+    }
+
+    long long start = now_ns();
+    for (int i = 0; i < samples; i++)
+        mem_free(blocks[i]);
+    long long sample_ns = now_ns() - start;
+
+    free(blocks);
+    mem_deinit();
+
+    printf_yellow("  live blocks: %8d  mem_free: %8.1f ns/op\n", live_blocks, (double)sample_ns / samples);
+}
+
+typedef struct
+{
+    int ops;  // Number of alloc/free pairs to run
+    int seed; // Seed for the per-thread size sequence
+} churn_args_t;
+
+// Keeps a small ring of live blocks, replacing the oldest one on every step
+void *thread_churn(void *arg)
+{
+    churn_args_t *args = (churn_args_t *)arg;
+    unsigned int seed = args->seed;
+    void *ring[32] = {0};
+
+    for (int i = 0; i < args->ops; i++)
+    {
+        int slot = i % 32;
+        if (ring[slot])
+            mem_free(ring[slot]);
+        ring[slot] = mem_alloc(16 + rand_r(&seed) % 240);
+        my_assert(ring[slot] != NULL);
+    }
+    for (int slot = 0; slot < 32; slot++)
+        if (ring[slot])
+            mem_free(ring[slot]);
+    return NULL;
+}
+
+/*
+ * Measures alloc/free throughput of `num_threads` threads churning small
+ * blocks, with the pool configured by `config`. The total number of operations
+ * is fixed, so ideal scaling shows up as constant or falling wall time.
+ */
+void bench_thread_churn(mem_config_t config, int num_threads, int total_ops)
+{
+    config.size = (size_t)num_threads * 32 * 512 + (1 << 20);
+    mem_init_ex(&config);
+
+    pthread_t threads[num_threads];
+    churn_args_t args[num_threads];
+
+    long long start = now_ns();
+    for (int i = 0; i < num_threads; i++)
+    {
+        args[i].ops = total_ops / num_threads;
+        args[i].seed = i + 1;
+        pthread_create(&threads[i], NULL, thread_churn, &args[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    long long elapsed = now_ns() - start;
+
+    mem_deinit();
+
+    printf_yellow("  threads: %4d  %8.2f Mops/s\n", num_threads, total_ops / (elapsed / 1e3));
+}
+
+/*
+ * The churn of bench_thread_churn run by `num_procs` forked processes on a
+ * pool in shared memory, whose lock is a process-shared robust mutex.
+ */
+void bench_process_churn(int num_procs, int total_ops)
+{
+    my_assert(mem_init_shared(NULL, (size_t)num_procs * 32 * 512 + (1 << 20)) == MEM_FILE_CREATED);
+
+    long long start = now_ns();
+    for (int i = 0; i < num_procs; i++)
+    {
+        if (fork() == 0)
+        {
+            churn_args_t args = {.ops = total_ops / num_procs, .seed = i + 1};
+            thread_churn(&args);
+            _exit(0);
+        }
+    }
+    for (int i = 0; i < num_procs; i++)
+        wait(NULL);
+    long long elapsed = now_ns() - start;
+
+    mem_deinit();
+
+    printf_yellow("  processes: %4d  %8.2f Mops/s\n", num_procs, total_ops / (elapsed / 1e3));
+}
+
+typedef struct
+{
+    mem_slab_t *slab; // Slab to allocate from, NULL to use mem_alloc
+    int ops;
+} node_args_t;
+
+// Allocates and frees 16-byte objects in bursts of 64, like list nodes
+void *thread_nodes(void *arg)
+{
+    node_args_t *args = (node_args_t *)arg;
+    void *nodes[64];
+
+    for (int i = 0; i < args->ops; i += 64)
+    {
+        for (int j = 0; j < 64; j++)
+            nodes[j] = args->slab ? mem_slab_alloc(args->slab) : mem_alloc(16);
+        for (int j = 0; j < 64; j++)
+        {
+            if (args->slab)
+                mem_slab_free(args->slab, nodes[j]);
+            else
+                mem_free(nodes[j]);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Compares 16-byte object allocation through mem_alloc with a slab.
+ */
+void bench_slab_vs_alloc(int use_slab, int num_threads, int total_ops)
+{
+    mem_init((size_t)num_threads * 64 * 64 + (1 << 20));
+    mem_slab_t *slab = use_slab ? mem_slab_create(16) : NULL;
+
+    pthread_t threads[num_threads];
+    node_args_t args[num_threads];
+
+    long long start = now_ns();
+    for (int i = 0; i < num_threads; i++)
+    {
+        args[i].slab = slab;
+        args[i].ops = total_ops / num_threads;
+        pthread_create(&threads[i], NULL, thread_nodes, &args[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    long long elapsed = now_ns() - start;
+
+    mem_slab_destroy(slab);
+    mem_deinit();
+
+    printf_yellow("  threads: %4d  %8.2f Mops/s\n", num_threads, total_ops / (elapsed / 1e3));
+}
+
+// Returns the largest block mem_alloc can currently hand out (binary search)
+size_t largest_allocatable(size_t limit)
+{
+    size_t low = 0, high = limit;
+    while (low < high)
+    {
+        size_t mid = low + (high - low + 1) / 2;
+        void *block = mem_alloc(mid);
+        if (block)
+        {
+            mem_free(block);
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/*
+ * Mixed-size churn in the style of test_memory_fragmentation_multithread:
+ * `live` slots of 16..2048 bytes are repeatedly replaced at random. Reports
+ * throughput, the share of allocations that failed because no free block
+ * fitted, and the largest block available once everything has been freed.
+ */
+void bench_mixed_churn(mem_backend_t backend, const char *name, size_t pool_size, int live, int ops)
+{
+    mem_init_ex(&(mem_config_t){.size = pool_size, .backend = backend});
+
+    void **slots = calloc(live, sizeof(void *));
+    unsigned int seed = 7;
+    int failures = 0;
+
+    long long start = now_ns();
+    for (int i = 0; i < ops; i++)
+    {
+        int slot = rand_r(&seed) % live;
+        if (slots[slot])
+            mem_free(slots[slot]);
+        slots[slot] = mem_alloc(16 + rand_r(&seed) % 2033);
+        if (!slots[slot])
+            failures++;
+    }
+    long long elapsed = now_ns() - start;
+
+    for (int i = 0; i < live; i++)
+        if (slots[i])
+            mem_free(slots[i]);
+    size_t largest = largest_allocatable(pool_size);
+
+    free(slots);
+    mem_deinit();
+
+    printf_yellow("  %-6s %8.2f Mops/s  failed allocs: %6.2f%%  largest free block after release: %5.1f%% of pool\n",
+                  name, ops / (elapsed / 1e3), 100.0 * failures / ops, 100.0 * largest / pool_size);
+}
+
+/*
+ * The mixed-size churn of bench_mixed_churn on the list backend under one
+ * placement policy. Besides throughput and failures it reports how the free
+ * memory is split up while the blocks are live, from mem_stats. With
+ * `wide_sizes` the requests range from 16 bytes to 64 KiB, log-uniformly.
+ */
+void bench_placement(mem_placement_t placement, const char *name, size_t pool_size, int live, int ops, int wide_sizes)
+{
+    mem_init_ex(&(mem_config_t){.size = pool_size, .placement = placement});
+
+    void **slots = calloc(live, sizeof(void *));
+    unsigned int seed = 7;
+    int failures = 0;
+
+    long long start = now_ns();
+    for (int i = 0; i < ops; i++)
+    {
+        int slot = rand_r(&seed) % live;
+        if (slots[slot])
+            mem_free(slots[slot]);
+        size_t size = 16 + rand_r(&seed) % 2033;
+        if (wide_sizes)
+        {
+            size = (size_t)16 << (rand_r(&seed) % 12);
+            size += rand_r(&seed) % size;
+        }
+        slots[slot] = mem_alloc(size);
+        if (!slots[slot])
+            failures++;
+    }
+    long long elapsed = now_ns() - start;
+
+    mem_stats_t stats;
+    mem_stats(&stats);
+    for (int i = 0; i < live; i++)
+        if (slots[i])
+            mem_free(slots[i]);
+    size_t largest = largest_allocatable(pool_size);
+
+    free(slots);
+    mem_deinit();
+
+    printf_yellow("  %-9s %8.2f Mops/s  failed allocs: %6.2f%%  free blocks: %6zu  fragmentation: %5.1f%%  largest free block after release: %5.1f%% of pool\n",
+                  name, ops / (elapsed / 1e3), 100.0 * failures / ops, stats.free_blocks, 100.0 * stats.fragmentation,
+                  100.0 * largest / pool_size);
+}
+
+int compare_ns(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts `samples` in place and prints its median, tail percentiles and maximum
+void print_percentiles(const char *label, long long *samples, int count)
+{
+    qsort(samples, count, sizeof(long long), compare_ns);
+    printf_yellow("    %-10s p50: %6lld ns  p99: %6lld ns  p99.9: %7lld ns  max: %8lld ns\n", label,
+                  samples[count / 2], samples[(int)(count * 0.99)], samples[(int)(count * 0.999)], samples[count - 1]);
+}
+
+/*
+ * Times every single mem_alloc and mem_free while `live` blocks of 16..4096
+ * bytes are randomly replaced in a pool kept about two-thirds full. Averages
+ * hide the occasional long free-list search; the p99/p99.9 columns show it.
+ */
+void bench_tail_latency(mem_backend_t backend, const char *name, int live, int ops)
+{
+    size_t pool_size = (size_t)live * 2056 * 3 / 2;
+    mem_init_ex(&(mem_config_t){.size = pool_size, .backend = backend});
+
+    void **slots = calloc(live, sizeof(void *));
+    long long *alloc_ns = malloc(ops * sizeof(long long));
+    long long *free_ns = malloc(ops * sizeof(long long));
+    unsigned int seed = 11;
+    int frees = 0, failures = 0;
+
+    for (int i = 0; i < live; i++)
+        slots[i] = mem_alloc(16 + rand_r(&seed) % 4081);
+
+    for (int i = 0; i < ops; i++)
+    {
+        int slot = rand_r(&seed) % live;
+        size_t size = 16 + rand_r(&seed) % 4081;
+        long long start;
+        if (slots[slot])
+        {
+            start = now_ns();
+            mem_free(slots[slot]);
+            free_ns[frees++] = now_ns() - start;
+        }
+        start = now_ns();
+        slots[slot] = mem_alloc(size);
+        alloc_ns[i] = now_ns() - start;
+        if (!slots[slot])
+            failures++;
+    }
+
+    printf("  %s (failed allocs: %.2f%%)\n", name, 100.0 * failures / ops);
+    print_percentiles("mem_alloc", alloc_ns, ops);
+    print_percentiles("mem_free", free_ns, frees);
+
+    for (int i = 0; i < live; i++)
+        if (slots[i])
+            mem_free(slots[i]);
+    free(alloc_ns);
+    free(free_ns);
+    free(slots);
+    mem_deinit();
+}
+
+/*
+ * Grows `buffers` buffers side by side from 16 bytes to `max_size` by
+ * doubling, the way dynamic arrays and string builders do, and frees them;
+ * `rounds` times over. With `use_resize` the growth goes through mem_resize,
+ * otherwise through mem_alloc + memcpy + mem_free. Reports time per growth
+ * step and how many steps kept the buffer where it was.
+ */
+void bench_doubling(mem_backend_t backend, const char *name, int use_resize, int buffers, size_t max_size, int rounds)
+{
+    mem_init_ex(&(mem_config_t){.size = (size_t)buffers * max_size * 4, .backend = backend});
+
+    char *buf[buffers];
+    long long steps = 0, in_place = 0;
+    long long start = now_ns();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int b = 0; b < buffers; b++)
+        {
+            buf[b] = mem_alloc(16);
+            memset(buf[b], b, 16);
+        }
+        for (size_t size = 32; size <= max_size; size *= 2)
+        {
+            for (int b = 0; b < buffers; b++)
+            {
+                char *grown;
+                if (use_resize)
+                {
+                    grown = mem_resize(buf[b], size);
+                }
+                else
+                {
+                    grown = mem_alloc(size);
+                    if (grown)
+                    {
+                        memcpy(grown, buf[b], size / 2);
+                        mem_free(buf[b]);
+                    }
+                }
+                my_assert(grown != NULL);
+                in_place += grown == buf[b];
+                steps++;
+                // Touch the new half as a growing array would
+                memset(grown + size / 2, b, size / 2);
+                buf[b] = grown;
+            }
+        }
+        for (int b = 0; b < buffers; b++)
+            mem_free(buf[b]);
+    }
+    long long elapsed = now_ns() - start;
+    mem_deinit();
+
+    printf_yellow("  %-6s %-22s %8.1f ns/step  in place: %5.1f%%\n", name,
+                  use_resize ? "mem_resize" : "mem_alloc+memcpy+free", (double)elapsed / steps, 100.0 * in_place / steps);
+}
+
+// Minor page faults taken by the process so far
+long minor_faults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+/*
+ * Sets up a pool of `pool_size` bytes obtained as selected by `map_flags`,
+ * takes it as one block and writes one byte per 4 KiB page (first touch),
+ * then does dependent random 8-byte reads across it (TLB reach). Reports
+ * init time, the page faults and time of the first touch, and the random
+ * read latency.
+ */
+void bench_first_touch(unsigned int map_flags, const char *name, size_t pool_size, int reads)
+{
+    long long start = now_ns();
+    mem_init_ex(&(mem_config_t){.size = pool_size, .map_flags = map_flags});
+    long long init_ns = now_ns() - start;
+
+    char *pool = mem_alloc(pool_size);
+    my_assert(pool != NULL);
+
+    long faults = minor_faults();
+    start = now_ns();
+    for (size_t off = 0; off < pool_size; off += 4096)
+        pool[off] = 1;
+    long long touch_ns = now_ns() - start;
+    faults = minor_faults() - faults;
+
+    // Chase a random cycle of 8-byte slots so every read waits for the last one
+    size_t slots = pool_size / sizeof(size_t);
+    size_t *next = (size_t *)pool;
+    unsigned int seed = 3;
+    for (size_t i = 0; i < slots; i++)
+        next[i] = i;
+    for (size_t i = slots - 1; i > 0; i--)
+    {
+        size_t j = (((size_t)rand_r(&seed) << 31) ^ rand_r(&seed)) % i;
+        size_t tmp = next[i];
+        next[i] = next[j];
+        next[j] = tmp;
+    }
+    size_t pos = 0;
+    start = now_ns();
+    for (int i = 0; i < reads; i++)
+        pos = next[pos];
+    long long read_ns = now_ns() - start;
+    my_assert(pos < slots);
+
+    mem_free(pool);
+    mem_deinit();
+
+    printf_yellow("  %-34s init: %8.2f ms  first touch: %7.2f ms (%7ld faults)  random read: %6.1f ns\n",
+                  name, init_ns / 1e6, touch_ns / 1e6, faults, (double)read_ns / reads);
+}
+
+/*
+ * Fills a pool with `total` bytes of `block_size`-byte blocks, timing every
+ * mem_alloc. The pool either holds all of it from the start or begins at
+ * `initial_size` and grows to fit. Growth maps a new chunk on a few of the
+ * calls; the percentiles show whether the others notice.
+ */
+void bench_growth(size_t initial_size, size_t total, size_t block_size)
+{
+    size_t pool_size = total + total / 8;
+    mem_init_ex(&(mem_config_t){.size = initial_size ? initial_size : pool_size, .max_size = initial_size ? pool_size : 0});
+
+    int count = (int)(total / block_size);
+    void **blocks = malloc(count * sizeof(void *));
+    long long *alloc_ns = malloc(count * sizeof(long long));
+    long long start = now_ns();
+    for (int i = 0; i < count; i++)
+    {
+        long long t = now_ns();
+        blocks[i] = mem_alloc(block_size);
+        alloc_ns[i] = now_ns() - t;
+        my_assert(blocks[i] != NULL);
+    }
+    long long elapsed = now_ns() - start;
+
+    for (int i = 0; i < count; i++)
+        mem_free(blocks[i]);
+    mem_deinit();
+
+    printf("  %s (%.1f ms in total)\n", initial_size ? "growable, 1 MiB initially" : "pre-sized", elapsed / 1e6);
+    print_percentiles("mem_alloc", alloc_ns, count);
+    free(alloc_ns);
+    free(blocks);
+}
+
+/*
+ * Allocates and frees `count` blocks of `block_size` bytes at a time,
+ * `rounds` times over, either with one mem_alloc/mem_free call per block or
+ * with mem_alloc_batch/mem_free_batch. The blocks are freed in the shuffled
+ * order a container would release them in. Reports time per block. With
+ * `tcache_count` the individual calls go through the thread caches, which
+ * the batch calls bypass.
+ */
+void bench_batch(mem_backend_t backend, size_t tcache_count, const char *name, int use_batch, size_t block_size, int count, int rounds)
+{
+    mem_init_ex(&(mem_config_t){.size = (size_t)count * block_size * 2, .backend = backend, .tcache_count = tcache_count});
+
+    void **blocks = malloc(count * sizeof(void *));
+    int *order = malloc(count * sizeof(int));
+    unsigned int seed = 9;
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    for (int i = count - 1; i > 0; i--)
+    {
+        int j = rand_r(&seed) % (i + 1);
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    long long alloc_ns = 0, free_ns = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        long long start = now_ns();
+        if (use_batch)
+        {
+            my_assert(mem_alloc_batch(block_size, count, blocks) == (size_t)count);
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+                blocks[i] = mem_alloc(block_size);
+        }
+        alloc_ns += now_ns() - start;
+
+        for (int i = 0; i < count; i++)
+        {
+            void *tmp = blocks[i];
+            blocks[i] = blocks[order[i]];
+            blocks[order[i]] = tmp;
+        }
+
+        start = now_ns();
+        if (use_batch)
+        {
+            mem_free_batch(blocks, count);
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+                mem_free(blocks[i]);
+        }
+        free_ns += now_ns() - start;
+    }
+
+    free(order);
+    free(blocks);
+    mem_deinit();
+
+    long long ops = (long long)count * rounds;
+    printf_yellow("  %-11s %-18s n: %5d  alloc: %6.1f ns/block  free: %6.1f ns/block\n", name,
+                  use_batch ? "batch" : "individual calls", count, (double)alloc_ns / ops, (double)free_ns / ops);
+}
+
+/*
+ * Request-scoped allocation: each of `requests` requests allocates `objects`
+ * objects of 16..128 bytes and then discards them all, either freeing each
+ * object with mem_free or releasing a region in one call. Reports time per
+ * object, allocation and release together.
+ */
+void bench_region(mem_backend_t backend, const char *name, int use_region, int objects, int requests)
+{
+    mem_init_ex(&(mem_config_t){.size = (size_t)objects * 256 + (1 << 20), .backend = backend});
+
+    void **blocks = malloc(objects * sizeof(void *));
+    unsigned int seed = 13;
+    long long start = now_ns();
+    for (int r = 0; r < requests; r++)
+    {
+        if (use_region)
+        {
+            mem_region_t *region = mem_region_begin();
+            for (int i = 0; i < objects; i++)
+                my_assert(mem_region_alloc(region, 16 + rand_r(&seed) % 113) != NULL);
+            mem_region_release(region);
+        }
+        else
+        {
+            for (int i = 0; i < objects; i++)
+                blocks[i] = mem_alloc(16 + rand_r(&seed) % 113);
+            for (int i = 0; i < objects; i++)
+                mem_free(blocks[i]);
+        }
+    }
+    long long elapsed = now_ns() - start;
+
+    free(blocks);
+    mem_deinit();
+
+    printf_yellow("  %-5s %-18s %6.1f ns/object\n", name, use_region ? "region" : "mem_alloc/mem_free",
+                  (double)elapsed / ((long long)objects * requests));
+}
+
+/*
+ * Cost of the latency histograms: `ops` replacements of random blocks among
+ * `live` blocks of 16..1024 bytes, timed with no histograms and with each
+ * clock. Prints the percentiles the histograms recorded.
+ */
+void bench_latency_histograms(mem_latency_clock_t clock, const char *name, int live, int ops)
+{
+    static mem_histogram_t hist;
+    mem_init_ex(&(mem_config_t){.size = (size_t)live * 1100 + (1 << 20), .latency_clock = clock});
+
+    void **blocks = malloc(live * sizeof(void *));
+    unsigned int seed = 7;
+    for (int i = 0; i < live; i++)
+        blocks[i] = mem_alloc(16 + rand_r(&seed) % 1009);
+    long long start = now_ns();
+    for (int i = 0; i < ops; i++)
+    {
+        int victim = rand_r(&seed) % live;
+        mem_free(blocks[victim]);
+        blocks[victim] = mem_alloc(16 + rand_r(&seed) % 1009);
+        my_assert(blocks[victim] != NULL);
+    }
+    long long elapsed = now_ns() - start;
+
+    printf_yellow("  %-10s %6.1f ns per alloc/free pair\n", name, (double)elapsed / ops);
+    if (mem_latency_snapshot(&hist) == 0)
+        mem_histogram_print(&hist, stdout);
+    free(blocks);
+    mem_deinit();
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef VERSION
+    printf("Build Version; %s \n", VERSION);
+#endif
+    printf("Git Version; %s/%s \n", git_date, git_sha);
+
+    if (argc < 2)
+    {
+        printf("Usage: %s <benchmark>\n", argv[0]);
+        printf("Available benchmarks:\n");
+        printf("  0. run all benchmarks\n");
+        printf("  1. mem_alloc latency at 10^3 to 10^6 live blocks\n");
+        printf("  2. mem_free latency at 10^3 to 10^6 live blocks\n");
+        printf("  3. multithreaded alloc/free throughput with and without thread caches\n");
+        printf("  4. 16-byte objects: mem_alloc vs. slab\n");
+        printf("  5. mixed-size churn: throughput and fragmentation per backend\n");
+        printf("  6. mem_alloc/mem_free tail latency (p50/p99/p99.9/max) per backend\n");
+        printf("  7. doubling buffers: mem_resize vs. alloc + copy + free\n");
+        printf("  8. pool backing: first-touch cost and random-access latency for heap/mmap/huge pages\n");
+        printf("  9. pool growth: mem_alloc latency of a growable pool vs. a pre-sized one\n");
+        printf("  10. batches of 64-byte blocks: mem_alloc_batch/mem_free_batch vs. individual calls\n");
+        printf("  11. request-scoped objects: region vs. mem_alloc/mem_free\n");
+        printf("  12. latency histograms: recording overhead per clock\n");
+        printf("  13. shared-memory pool: alloc/free throughput of processes vs. threads\n");
+        printf("  14. placement policies: throughput and fragmentation of class, first, next and best fit\n");
+        return 1;
+    }
+
+    int bench = atoi(argv[1]);
+
+    if (bench == 0 || bench == 1)
+    {
+        printf("\n*** mem_alloc latency vs. number of live blocks: ***\n");
+        printf("list backend:\n");
+        for (int live_blocks = 1000; live_blocks <= 1000000; live_blocks *= 10)
+            bench_alloc_latency_live_blocks(MEM_BACKEND_LIST, live_blocks, 10000);
+        printf("boundary-tag backend:\n");
+        for (int live_blocks = 1000; live_blocks <= 1000000; live_blocks *= 10)
+            bench_alloc_latency_live_blocks(MEM_BACKEND_TAGS, live_blocks, 10000);
+    }
+
+    if (bench == 0 || bench == 2)
+    {
+        printf("\n*** mem_free latency vs. number of live blocks: ***\n");
+        printf("list backend:\n");
+        for (int live_blocks = 1000; live_blocks <= 1000000; live_blocks *= 10)
+            bench_free_latency_live_blocks(MEM_BACKEND_LIST, live_blocks, 1000);
+        printf("boundary-tag backend:\n");
+        for (int live_blocks = 1000; live_blocks <= 1000000; live_blocks *= 10)
+            bench_free_latency_live_blocks(MEM_BACKEND_TAGS, live_blocks, 1000);
+    }
+
+    if (bench == 0 || bench == 3)
+    {
+        printf("\n*** Multithreaded alloc/free throughput (2M pairs in total): ***\n");
+        printf("global lock only:\n");
+        for (int threads = 1; threads <= 256; threads *= 4)
+            bench_thread_churn((mem_config_t){0}, threads, 2000000);
+        printf("thread caches (64 blocks per class):\n");
+        for (int threads = 1; threads <= 256; threads *= 4)
+            bench_thread_churn((mem_config_t){.tcache_count = 64}, threads, 2000000);
+        printf("8 arenas, round-robin:\n");
+        for (int threads = 1; threads <= 256; threads *= 4)
+            bench_thread_churn((mem_config_t){.arenas = 8}, threads, 2000000);
+        printf("8 arenas, per CPU:\n");
+        for (int threads = 1; threads <= 256; threads *= 4)
+            bench_thread_churn((mem_config_t){.arenas = 8, .arena_policy = MEM_ARENA_PER_CPU}, threads, 2000000);
+        printf("8 arenas with thread caches:\n");
+        for (int threads = 1; threads <= 256; threads *= 4)
+            bench_thread_churn((mem_config_t){.arenas = 8, .tcache_count = 64}, threads, 2000000);
+    }
+
+    if (bench == 0 || bench == 4)
+    {
+        printf("\n*** 16-byte objects, 2M alloc/free pairs in total: ***\n");
+        printf("mem_alloc/mem_free:\n");
+        for (int threads = 1; threads <= 64; threads *= 4)
+            bench_slab_vs_alloc(0, threads, 2000000);
+        printf("mem_slab_alloc/mem_slab_free:\n");
+        for (int threads = 1; threads <= 64; threads *= 4)
+            bench_slab_vs_alloc(1, threads, 2000000);
+    }
+
+    if (bench == 0 || bench == 5)
+    {
+        printf("\n*** Mixed-size churn (4 MiB pool, 2000 live blocks of 16..2048 bytes, 1M replacements): ***\n");
+        bench_mixed_churn(MEM_BACKEND_LIST, "list", 4 << 20, 2000, 1000000);
+        bench_mixed_churn(MEM_BACKEND_TAGS, "tags", 4 << 20, 2000, 1000000);
+        bench_mixed_churn(MEM_BACKEND_BUDDY, "buddy", 4 << 20, 2000, 1000000);
+        bench_mixed_churn(MEM_BACKEND_TLSF, "tlsf", 4 << 20, 2000, 1000000);
+        printf("Same workload at high occupancy (2.5 MiB pool):\n");
+        bench_mixed_churn(MEM_BACKEND_LIST, "list", 5 << 19, 2000, 1000000);
+        bench_mixed_churn(MEM_BACKEND_TAGS, "tags", 5 << 19, 2000, 1000000);
+        bench_mixed_churn(MEM_BACKEND_BUDDY, "buddy", 5 << 19, 2000, 1000000);
+        bench_mixed_churn(MEM_BACKEND_TLSF, "tlsf", 5 << 19, 2000, 1000000);
+    }
+
+    if (bench == 0 || bench == 6)
+    {
+        printf("\n*** Tail latency (20000 live blocks of 16..4096 bytes, 1M replacements): ***\n");
+        bench_tail_latency(MEM_BACKEND_LIST, "list", 20000, 1000000);
+        bench_tail_latency(MEM_BACKEND_TAGS, "tags", 20000, 1000000);
+        bench_tail_latency(MEM_BACKEND_BUDDY, "buddy", 20000, 1000000);
+        bench_tail_latency(MEM_BACKEND_TLSF, "tlsf", 20000, 1000000);
+    }
+
+    if (bench == 0 || bench == 7)
+    {
+        mem_backend_t backends[] = {MEM_BACKEND_LIST, MEM_BACKEND_TAGS, MEM_BACKEND_BUDDY, MEM_BACKEND_TLSF};
+        const char *names[] = {"list", "tags", "buddy", "tlsf"};
+        for (int buffers = 1; buffers <= 4; buffers *= 4)
+        {
+            printf("\n*** Doubling buffers (%d side by side, 16 bytes to 256 KiB, 500 rounds): ***\n", buffers);
+            for (int i = 0; i < 4; i++)
+            {
+                bench_doubling(backends[i], names[i], 0, buffers, 256 * 1024, 500);
+                bench_doubling(backends[i], names[i], 1, buffers, 256 * 1024, 500);
+            }
+        }
+    }
+
+    if (bench == 0 || bench == 8)
+    {
+        size_t pool_size = (size_t)256 << 20;
+        printf("\n*** Pool backing (256 MiB pool, first touch of every 4 KiB page, 20M dependent random reads): ***\n");
+        bench_first_touch(0, "heap (posix_memalign)", pool_size, 20000000);
+        bench_first_touch(MEM_MAP_ANONYMOUS, "mmap", pool_size, 20000000);
+        bench_first_touch(MEM_MAP_POPULATE, "mmap + MAP_POPULATE", pool_size, 20000000);
+        bench_first_touch(MEM_MAP_HUGEPAGE, "mmap + MADV_HUGEPAGE", pool_size, 20000000);
+        bench_first_touch(MEM_MAP_HUGEPAGE | MEM_MAP_POPULATE, "mmap + MADV_HUGEPAGE + prefault", pool_size, 20000000);
+        bench_first_touch(MEM_MAP_HUGETLB | MEM_MAP_POPULATE, "mmap + MAP_HUGETLB (or fallback)", pool_size, 20000000);
+    }
+
+    if (bench == 0 || bench == 9)
+    {
+        printf("\n*** Pool growth (256 MiB in 256-byte blocks): ***\n");
+        bench_growth(0, (size_t)256 << 20, 256);
+        bench_growth((size_t)1 << 20, (size_t)256 << 20, 256);
+    }
+
+    if (bench == 0 || bench == 10)
+    {
+        printf("\n*** Batches of 64-byte blocks (2M blocks in total): ***\n");
+        for (int count = 16; count <= 4096; count *= 16)
+        {
+            bench_batch(MEM_BACKEND_LIST, 0, "list", 0, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_LIST, 0, "list", 1, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_TAGS, 0, "tags", 0, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_TAGS, 0, "tags", 1, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_TLSF, 0, "TLSF", 0, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_TLSF, 0, "TLSF", 1, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_LIST, 64, "list+tcache", 0, 64, count, 2000000 / count);
+            bench_batch(MEM_BACKEND_LIST, 64, "list+tcache", 1, 64, count, 2000000 / count);
+        }
+    }
+
+    if (bench == 0 || bench == 11)
+    {
+        printf("\n*** Request-scoped objects (1000 objects of 16..128 bytes per request, 2000 requests): ***\n");
+        bench_region(MEM_BACKEND_LIST, "list", 0, 1000, 2000);
+        bench_region(MEM_BACKEND_LIST, "list", 1, 1000, 2000);
+        bench_region(MEM_BACKEND_TAGS, "tags", 0, 1000, 2000);
+        bench_region(MEM_BACKEND_TAGS, "tags", 1, 1000, 2000);
+    }
+
+    if (bench == 0 || bench == 12)
+    {
+        printf("\n*** Latency histograms (10000 live blocks of 16..1024 bytes, 2M replacements): ***\n");
+        bench_latency_histograms(MEM_CLOCK_NONE, "off", 10000, 2000000);
+        bench_latency_histograms(MEM_CLOCK_MONOTONIC, "monotonic", 10000, 2000000);
+        bench_latency_histograms(MEM_CLOCK_TSC, "TSC", 10000, 2000000);
+    }
+
+    if (bench == 0 || bench == 13)
+    {
+        printf("\n*** Shared-memory pool (2M alloc/free pairs in total): ***\n");
+        printf("threads, process-private pool (tags backend):\n");
+        for (int workers = 1; workers <= 16; workers *= 4)
+            bench_thread_churn((mem_config_t){.backend = MEM_BACKEND_TAGS}, workers, 2000000);
+        printf("processes, shared pool:\n");
+        for (int workers = 1; workers <= 16; workers *= 4)
+            bench_process_churn(workers, 2000000);
+    }
+
+    if (bench == 0 || bench == 14)
+    {
+        printf("\n*** Placement policies, list backend (2000 live blocks of 16..2048 bytes, 1M replacements): ***\n");
+        printf("4 MiB pool:\n");
+        bench_placement(MEM_PLACE_CLASS_FIT, "class fit", 4 << 20, 2000, 1000000, 0);
+        bench_placement(MEM_PLACE_FIRST_FIT, "first fit", 4 << 20, 2000, 1000000, 0);
+        bench_placement(MEM_PLACE_NEXT_FIT, "next fit", 4 << 20, 2000, 1000000, 0);
+        bench_placement(MEM_PLACE_BEST_FIT, "best fit", 4 << 20, 2000, 1000000, 0);
+        printf("2.5 MiB pool (high occupancy):\n");
+        bench_placement(MEM_PLACE_CLASS_FIT, "class fit", 5 << 19, 2000, 1000000, 0);
+        bench_placement(MEM_PLACE_FIRST_FIT, "first fit", 5 << 19, 2000, 1000000, 0);
+        bench_placement(MEM_PLACE_NEXT_FIT, "next fit", 5 << 19, 2000, 1000000, 0);
+        bench_placement(MEM_PLACE_BEST_FIT, "best fit", 5 << 19, 2000, 1000000, 0);
+        printf("Widely varying sizes (20000 live blocks of 16 bytes..64 KiB, 200K replacements, 256 MiB pool):\n");
+        bench_placement(MEM_PLACE_CLASS_FIT, "class fit", 256 << 20, 20000, 200000, 1);
+        bench_placement(MEM_PLACE_FIRST_FIT, "first fit", 256 << 20, 20000, 200000, 1);
+        bench_placement(MEM_PLACE_NEXT_FIT, "next fit", 256 << 20, 20000, 200000, 1);
+        bench_placement(MEM_PLACE_BEST_FIT, "best fit", 256 << 20, 20000, 200000, 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+// heap_map.c
+//
+// Renders a block map written by mem_dump: per-arena occupancy and
+// fragmentation, the sizes of the free blocks and a picture of the pool in
+// which every character stands for an equal slice of it.
+//
+// Usage: heap_map <dump.csv> [columns]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAP_ROWS 16
+#define MAX_ARENAS 256
+#define SIZE_BUCKETS 64
+
+typedef struct {
+    int arena;
+    size_t offset;
+    size_t size;
+    int is_free;
+} BlockEntry;
+
+typedef struct {
+    size_t used_blocks;
+    size_t used_bytes;
+    size_t free_blocks;
+    size_t free_bytes;
+    size_t largest_free;
+    size_t end; // Highest offset past any block
+} ArenaSummary;
+
+static int floor_log2(size_t size) {
+    return size <= 1 ? 0 : 63 - __builtin_clzll((unsigned long long)size);
+}
+
+// 1 - largest free block / free bytes: how much of the free memory a single
+// request cannot use, as in mem_stats
+static double fragmentation(const ArenaSummary* summary) {
+    return summary->free_bytes ? 1.0 - (double)summary->largest_free / summary->free_bytes : 0.0;
+}
+
+static void add_block(ArenaSummary* summary, const BlockEntry* block) {
+    if (block->is_free) {
+        summary->free_blocks++;
+        summary->free_bytes += block->size;
+        if (block->size > summary->largest_free) {
+            summary->largest_free = block->size;
+        }
+    } else {
+        summary->used_blocks++;
+        summary->used_bytes += block->size;
+    }
+    if (block->offset + block->size > summary->end) {
+        summary->end = block->offset + block->size;
+    }
+}
+
+static void print_summary(const char* name, const ArenaSummary* summary) {
+    printf("%-8s %12zu %8zu %12zu %8zu %12zu %7.1f%%\n", name, summary->used_bytes, summary->used_blocks,
+           summary->free_bytes, summary->free_blocks, summary->largest_free, 100.0 * fragmentation(summary));
+}
+
+// Reads the dump into a growing array. Returns NULL if the file cannot be read.
+static BlockEntry* read_dump(const char* path, size_t* count, size_t* pool_size, char* backend, size_t backend_len) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return NULL;
+    }
+
+    BlockEntry* blocks = NULL;
+    size_t capacity = 0;
+    char line[256];
+    char state[16];
+    *count = 0;
+    *pool_size = 0;
+    snprintf(backend, backend_len, "unknown");
+    while (fgets(line, sizeof(line), in)) {
+        if (line[0] == '#') {
+            char name[64];
+            if (sscanf(line, "# %63s pool of %zu bytes", name, pool_size) == 2) {
+                snprintf(backend, backend_len, "%s", name);
+            }
+            continue;
+        }
+
+        BlockEntry block;
+        if (sscanf(line, "%d,%zu,%zu,%15s", &block.arena, &block.offset, &block.size, state) != 4) {
+            continue; // The column header, or a line we do not understand
+        }
+        block.is_free = strcmp(state, "free") == 0;
+        if (*count == capacity) {
+            capacity = capacity ? 2 * capacity : 1024;
+            BlockEntry* grown = (BlockEntry*)realloc(blocks, capacity * sizeof(BlockEntry));
+            if (!grown) {
+                fprintf(stderr, "Out of memory reading %s\n", path);
+                free(blocks);
+                fclose(in);
+                return NULL;
+            }
+            blocks = grown;
+        }
+        blocks[(*count)++] = block;
+    }
+    fclose(in);
+    return blocks ? blocks : (BlockEntry*)calloc(1, sizeof(BlockEntry));
+}
+
+// Prints the pool as MAP_ROWS rows of `columns` cells: '#' for a slice that is
+// all allocated, '.' all free, '+' mostly and '-' partly allocated, and ' '
+// for a slice no block covers (backend metadata or slack at an arena's end)
+static void print_map(const BlockEntry* blocks, size_t count, size_t span, int columns) {
+    size_t cells = (size_t)MAP_ROWS * columns;
+    size_t cell_bytes = (span + cells - 1) / cells;
+    if (cell_bytes == 0) {
+        return;
+    }
+    size_t* used = (size_t*)calloc(cells, sizeof(size_t));
+    size_t* covered = (size_t*)calloc(cells, sizeof(size_t));
+    if (!used || !covered) {
+        free(used);
+        free(covered);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t start = blocks[i].offset, end = blocks[i].offset + blocks[i].size;
+        for (size_t cell = start / cell_bytes; cell < cells && cell * cell_bytes < end; cell++) {
+            size_t lo = cell * cell_bytes > start ? cell * cell_bytes : start;
+            size_t hi = (cell + 1) * cell_bytes < end ? (cell + 1) * cell_bytes : end;
+            covered[cell] += hi - lo;
+            if (!blocks[i].is_free) {
+                used[cell] += hi - lo;
+            }
+        }
+    }
+
+    printf("\nMap, %zu bytes per character:\n", cell_bytes);
+    for (size_t row = 0; row < MAP_ROWS; row++) {
+        printf("%12zu |", row * columns * cell_bytes);
+        for (int col = 0; col < columns; col++) {
+            size_t cell = row * columns + col;
+            char c = ' ';
+            if (covered[cell]) {
+                if (used[cell] == 0) {
+                    c = '.';
+                } else if (used[cell] == covered[cell]) {
+                    c = '#';
+                } else {
+                    c = 2 * used[cell] >= covered[cell] ? '+' : '-';
+                }
+            }
+            putchar(c);
+        }
+        printf("|\n");
+    }
+    free(used);
+    free(covered);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <dump.csv> [columns]\n", argv[0]);
+        printf("Renders a block map written by mem_dump.\n");
+        return 1;
+    }
+    int columns = argc > 2 ? atoi(argv[2]) : 64;
+    if (columns <= 0) {
+        columns = 64;
+    }
+
+    size_t count, pool_size;
+    char backend[64];
+    BlockEntry* blocks = read_dump(argv[1], &count, &pool_size, backend, sizeof(backend));
+    if (!blocks) {
+        return 1;
+    }
+
+    static ArenaSummary arenas[MAX_ARENAS];
+    ArenaSummary total = {0};
+    size_t free_sizes[SIZE_BUCKETS] = {0};
+    int arena_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        int arena = blocks[i].arena;
+        if (arena >= 0 && arena < MAX_ARENAS) {
+            add_block(&arenas[arena], &blocks[i]);
+            if (arena + 1 > arena_count) {
+                arena_count = arena + 1;
+            }
+        }
+        add_block(&total, &blocks[i]);
+        if (blocks[i].is_free) {
+            free_sizes[floor_log2(blocks[i].size)]++;
+        }
+    }
+
+    printf("%s pool of %zu bytes, %zu blocks\n\n", backend, pool_size, count);
+    printf("%-8s %12s %8s %12s %8s %12s %8s\n", "arena", "used bytes", "blocks", "free bytes", "blocks", "largest free", "frag");
+    for (int i = 0; i < arena_count; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%d", i);
+        print_summary(name, &arenas[i]);
+    }
+    print_summary("total", &total);
+
+    printf("\nFree blocks by size:\n");
+    for (int k = 0; k < SIZE_BUCKETS; k++) {
+        if (free_sizes[k]) {
+            printf("  %12zu - %-12zu %8zu\n", (size_t)1 << k, ((size_t)2 << k) - 1, free_sizes[k]);
+        }
+    }
+
+    print_map(blocks, count, pool_size ? pool_size : total.end, columns);
+    free(blocks);
+    return 0;
+}
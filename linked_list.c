@@ -9,24 +9,43 @@ typedef struct Node {
     struct Node* next;    // Pointer to the next node in the list.
 } Node;
 
+// The list gets a pool of its own, so it neither clobbers nor contends with
+// the default pool the application may be using. Nodes all have the same
+// size, so they come from a slab carved out of that pool instead of going
+// through the general-purpose allocator.
+static mem_pool_t* list_pool = NULL;
+static mem_slab_t* node_slab = NULL;
+
 // Synchronization primitives for thread safety.
 pthread_rwlock_t list_rwlock = PTHREAD_RWLOCK_INITIALIZER; // Read-Write lock for read-heavy functions.
 pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;    // Mutex lock for write-heavy functions.
 
-// Initializes a linked list and the custom memory manager.
+// Initializes a linked list and its memory pool.
 // Parameters:
 // - head: Pointer to the head pointer of the linked list.
 // - size: Size of the memory pool to be initialized.
 void list_init(Node** head, size_t size) {
     *head = NULL;
-    mem_init(size);
+    // Room for as many nodes as fit in `size` bytes, in whole slab pages
+    size_t nodes = (size + sizeof(Node) - 1) / sizeof(Node);
+    list_pool = mem_pool_create(&(mem_config_t){.size = mem_slab_pool_size(sizeof(Node), nodes)});
+    if (!list_pool) {
+        printf("Memory pool creation failed\n");
+        return;
+    }
+    node_slab = mem_pool_slab_create(list_pool, sizeof(Node));
+    if (!node_slab) {
+        printf("Node slab creation failed\n");
+        mem_pool_destroy(list_pool);
+        list_pool = NULL;
+    }
 }
 
 // Inserts a new node at the end of the list.
 void list_insert(Node** head, uint16_t data) {
     pthread_mutex_lock(&list_mutex); // Exclusive lock for write operation
 
-    Node* new_node = (Node*)mem_alloc(sizeof(Node));
+    Node* new_node = node_slab ? (Node*)mem_slab_alloc(node_slab) : NULL; // NULL if list_init failed
     if (!new_node) {
         printf("Memory allocation failed\n");
         pthread_mutex_unlock(&list_mutex); // Release lock on failure
@@ -58,7 +77,7 @@ void list_insert_after(Node* prev_node, uint16_t data) {
 
     pthread_mutex_lock(&list_mutex); // Exclusive lock for write operation
 
-    Node* new_node = (Node*)mem_alloc(sizeof(Node));
+    Node* new_node = node_slab ? (Node*)mem_slab_alloc(node_slab) : NULL;
     if (!new_node) {
         printf("Memory allocation failed\n");
         pthread_mutex_unlock(&list_mutex); // Release lock on failure
@@ -81,7 +100,7 @@ void list_insert_before(Node** head, Node* next_node, uint16_t data) {
 
     pthread_mutex_lock(&list_mutex); // Exclusive lock for write operation
 
-    Node* new_node = (Node*)mem_alloc(sizeof(Node));
+    Node* new_node = node_slab ? (Node*)mem_slab_alloc(node_slab) : NULL;
     if (!new_node) {
         printf("Memory allocation failed\n");
         pthread_mutex_unlock(&list_mutex); // Release lock on failure
@@ -100,7 +119,7 @@ void list_insert_before(Node** head, Node* next_node, uint16_t data) {
 
         if (current == NULL) {
             printf("The specified next node is not in the list\n");
-            mem_free(new_node);
+            mem_slab_free(node_slab, new_node);
             pthread_mutex_unlock(&list_mutex); // Release lock on failure
             return;
         }
@@ -142,7 +161,7 @@ void list_delete(Node** head, uint16_t data) {
         previous->next = current->next;
     }
 
-    mem_free(current);
+    mem_slab_free(node_slab, current);
 
     pthread_mutex_unlock(&list_mutex); // Release lock after deletion
 }
@@ -214,18 +233,16 @@ int list_count_nodes(Node** head) {
     return count;
 }
 
-// Frees all nodes in the list and deinitializes the memory manager.
+// Frees all nodes in the list and destroys its memory pool.
 void list_cleanup(Node** head) {
     pthread_mutex_lock(&list_mutex); // Exclusive lock for cleanup
 
-    Node* current = *head;
-    while (current != NULL) {
-        Node* next_node = current->next;
-        mem_free(current);
-        current = next_node;
-    }
+    // Destroying the slab releases every node at once
     *head = NULL;
-    mem_deinit();
+    mem_slab_destroy(node_slab);
+    node_slab = NULL;
+    mem_pool_destroy(list_pool);
+    list_pool = NULL;
 
     pthread_mutex_unlock(&list_mutex); // Release lock after cleanup
 }
@@ -1,190 +1,2885 @@
+#define _GNU_SOURCE // For sched_getcpu
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <pthread.h>
-
-pthread_mutex_t memory_mutex;
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // For __rdtsc
+#define HAVE_TSC 1
+#endif
+#include "memory_manager.h"
+#include "memory_manager_internal.h"
 
 // Structure to represent a memory block in the pool
 typedef struct Block {
     size_t size;           // Size of the block
     int is_free;           // 1 if the block is free, 0 if it is allocated
     struct Block* next;    // Pointer to the next block
+    struct Block* prev;    // The block just below this one, NULL for head_block
     void* ptr;             // Pointer to the memory within the pool
+    // A free block is either on a size-class list or, with best-fit
+    // placement, in the size tree; the links of the two share storage.
+    union {
+        struct {
+            struct Block* free_prev; // Previous block in the same size-class free list
+            struct Block* free_next; // Next block in the same size-class free list
+        };
+        struct {
+            struct Block* tree_left;  // Smaller free blocks in the size tree
+            struct Block* tree_right; // Larger free blocks in the size tree
+        };
+    };
 } Block;
 
-void* memory_pool = NULL;  // Pointer to the start of the memory pool
-Block* head_block = NULL;  // Head of the linked list of memory blocks
-size_t memory_pool_size = 0;
+// State of the list backend. Block metadata lives outside the pool, so the
+// whole pool is usable payload.
+typedef struct ListHeap {
+    Block* head_block;     // Head of the linked list of memory blocks
+    // Free blocks are kept in segregated lists, one per power-of-two size class.
+    // Class k holds free blocks whose size lies in [2^k, 2^(k+1)). A bit is
+    // set in free_list_bitmap for every
+    // non-empty class so the first usable class is found with a single scan.
+    Block* free_lists[NUM_SIZE_CLASSES];
+    uint64_t free_list_bitmap;
+    // With best-fit placement each class is a treap instead, ordered by size
+    // and then address, so the smallest block that fits is found in
+    // O(log n) without ever looking at the classes below the request. A
+    // block's heap priority is a hash of its address. The bitmap covers the
+    // trees the same way as the lists.
+    Block* size_trees[NUM_SIZE_CLASSES];
+    // Open-addressing hash table from block->ptr to Block, so a pointer is
+    // resolved in O(1) instead of by walking the block list. Every block,
+    // free or allocated, is in the table; map_capacity is a power of two.
+    Block** block_map;
+    size_t map_capacity;
+    size_t map_count;
+    size_t size;           // Bytes managed
+    size_t free_bytes;     // Total size of the blocks on the free lists
+    size_t free_blocks;    // Number of blocks on the free lists
+    size_t used_blocks;    // Number of allocated blocks
+    size_t peak_used;      // Highest number of bytes allocated at once
+    mem_placement_t placement; // How find_free_block picks among the blocks that fit
+    Block* rover;          // Where the next MEM_PLACE_NEXT_FIT search starts; NULL for head_block
+} ListHeap;
 
-// Initializes the memory pool with the specified size
-void mem_init(size_t size) {
-    pthread_mutex_init(&memory_mutex, NULL);
-    memory_pool = malloc(size);
-    if (!memory_pool) {
-        perror("Memory pool allocation failed");
-        exit(EXIT_FAILURE);
+#define BLOCK_MAP_MIN_CAPACITY 64
+
+// Orders the size tree: by size, and blocks of equal size by address
+static inline int tree_less(const Block* a, const Block* b) {
+    return a->size < b->size || (a->size == b->size && (uintptr_t)a->ptr < (uintptr_t)b->ptr);
+}
+
+// Heap priority of a block in the size tree (Fibonacci hashing of its address)
+static inline uint32_t tree_priority(const Block* block) {
+    return (uint32_t)(((uint64_t)(uintptr_t)block->ptr * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+// Inserts `block` below `*link`, rotating it up while its priority is higher
+// than its parent's
+static void tree_insert(Block** link, Block* block) {
+    Block* parent = *link;
+    if (!parent) {
+        block->tree_left = NULL;
+        block->tree_right = NULL;
+        *link = block;
+        return;
+    }
+    if (tree_less(block, parent)) {
+        tree_insert(&parent->tree_left, block);
+        if (tree_priority(parent->tree_left) > tree_priority(parent)) {
+            Block* child = parent->tree_left;
+            parent->tree_left = child->tree_right;
+            child->tree_right = parent;
+            *link = child;
+        }
+    } else {
+        tree_insert(&parent->tree_right, block);
+        if (tree_priority(parent->tree_right) > tree_priority(parent)) {
+            Block* child = parent->tree_right;
+            parent->tree_right = child->tree_left;
+            child->tree_left = parent;
+            *link = child;
+        }
     }
+}
 
-    memory_pool_size = size;
+// Joins two subtrees where every block of `left` orders before `right`
+static Block* tree_join(Block* left, Block* right) {
+    if (!left) {
+        return right;
+    }
+    if (!right) {
+        return left;
+    }
+    if (tree_priority(left) > tree_priority(right)) {
+        left->tree_right = tree_join(left->tree_right, right);
+        return left;
+    }
+    right->tree_left = tree_join(left, right->tree_left);
+    return right;
+}
 
-    head_block = (Block*)malloc(sizeof(Block));
-    if (!head_block) {
-        perror("Block metadata allocation failed");
-        free(memory_pool);
-        exit(EXIT_FAILURE);
+// Unlinks `block`, which must be in the tree, putting its subtrees in its place
+static void tree_remove(Block** link, Block* block) {
+    while (*link != block) {
+        link = tree_less(block, *link) ? &(*link)->tree_left : &(*link)->tree_right;
     }
+    *link = tree_join(block->tree_left, block->tree_right);
+}
 
-    head_block->size = size;
-    head_block->is_free = 1;
-    head_block->ptr = memory_pool;
-    head_block->next = NULL;
+// Returns the smallest block in the tree with at least `size` bytes, the
+// lowest-addressed one among equals
+static Block* tree_best_fit(Block* node, size_t size) {
+    Block* best = NULL;
+    while (node) {
+        if (node->size >= size) {
+            best = node;
+            node = node->tree_left;
+        } else {
+            node = node->tree_right;
+        }
+    }
+    return best;
+}
 
-    #ifdef DEBUG
-    printf("Initialized memory pool of size %zu at %p\n", size, memory_pool);
-    #endif
+// Reports every block of a subtree to `fn`, in size order
+static void tree_for_each(Block* node, mem_run_fn fn, void* ctx) {
+    while (node) {
+        tree_for_each(node->tree_left, fn, ctx);
+        fn(node->ptr, node->size, ctx);
+        node = node->tree_right;
+    }
 }
 
-void* mem_alloc(size_t size) {
-    
-    pthread_mutex_lock(&memory_mutex);
+// Adds a free block to its size class: to the head of the class's list, or
+// to its tree under best-fit placement
+static void free_list_insert(ListHeap* heap, Block* block) {
+    int cls = size_class(block->size);
 
-    Block* current = head_block;
-    while (current != NULL) {
-        if (current->is_free && current->size >= size) {
-            if (current->size > size) {
-                Block* new_block = (Block*)malloc(sizeof(Block));
-                if (!new_block) {
-                    perror("New block metadata allocation failed");
-                    pthread_mutex_unlock(&memory_mutex);
-                    return NULL;
-                }
-
-                new_block->size = current->size - size;
-                new_block->is_free = 1;
-                new_block->ptr = (char*)current->ptr + size;
-                new_block->next = current->next;
-
-                current->size = size;
-                current->is_free = 0;
-                current->next = new_block;
-            } else {
-                current->is_free = 0;
-            }
+    heap->free_list_bitmap |= (1ULL << cls);
+    heap->free_bytes += block->size;
+    heap->free_blocks++;
+    if (heap->placement == MEM_PLACE_BEST_FIT) {
+        tree_insert(&heap->size_trees[cls], block);
+        return;
+    }
+
+    block->free_prev = NULL;
+    block->free_next = heap->free_lists[cls];
+    if (heap->free_lists[cls]) {
+        heap->free_lists[cls]->free_prev = block;
+    }
+    heap->free_lists[cls] = block;
+}
 
-            #ifdef DEBUG
-            printf("Allocated %zu bytes at %p\n", size, current->ptr);
-            #endif
+// Takes a free block out of its size class
+static void free_list_remove(ListHeap* heap, Block* block) {
+    int cls = size_class(block->size);
 
-            pthread_mutex_unlock(&memory_mutex);
-            return current->ptr;
+    heap->free_bytes -= block->size;
+    heap->free_blocks--;
+    if (heap->placement == MEM_PLACE_BEST_FIT) {
+        tree_remove(&heap->size_trees[cls], block);
+        if (!heap->size_trees[cls]) {
+            heap->free_list_bitmap &= ~(1ULL << cls);
         }
-        current = current->next;
+        block->tree_left = NULL;
+        block->tree_right = NULL;
+        return;
     }
 
-    pthread_mutex_unlock(&memory_mutex);
-    return NULL;  // Allocation failed
+    if (block->free_prev) {
+        block->free_prev->free_next = block->free_next;
+    } else {
+        heap->free_lists[cls] = block->free_next;
+    }
+    if (block->free_next) {
+        block->free_next->free_prev = block->free_prev;
+    }
+    if (!heap->free_lists[cls]) {
+        heap->free_list_bitmap &= ~(1ULL << cls);
+    }
+    block->free_prev = NULL;
+    block->free_next = NULL;
 }
 
+// Records a new high-water mark of allocated bytes
+static inline void list_note_peak(ListHeap* heap) {
+    size_t used = heap->size - heap->free_bytes;
+    if (used > heap->peak_used) {
+        heap->peak_used = used;
+    }
+}
 
-// Frees a previously allocated block of memory
-void mem_free(void* ptr) {
-    if (!ptr) {
-        fprintf(stderr, "Warning: Attempted to free a NULL pointer.\n");
-        return;
+// Finds the first free block with at least `size` bytes in address order
+// from `start` up to, but not including, `stop`
+static Block* find_in_address_order(Block* start, Block* stop, size_t size) {
+    for (Block* current = start; current != stop; current = current->next) {
+        if (current->is_free && current->size >= size) {
+            return current;
+        }
     }
+    return NULL;
+}
 
-    pthread_mutex_lock(&memory_mutex);
+// Next fit: first fit starting at the rover, wrapping around to head_block once
+static Block* find_next_fit(ListHeap* heap, size_t size) {
+    Block* start = heap->rover ? heap->rover : heap->head_block;
+    Block* found = find_in_address_order(start, NULL, size);
+    return found ? found : find_in_address_order(heap->head_block, start, size);
+}
 
-    Block* current = head_block;
-    while (current != NULL) {
-        if (current->ptr == ptr) {
-            if (current->is_free) {
-                fprintf(stderr, "Warning: Attempted to free an already freed block at %p.\n", ptr);
-                pthread_mutex_unlock(&memory_mutex);
-                return;
-            }
+// Finds the smallest free block with at least `size` bytes. Every block in a
+// class is smaller than any block in the classes above it, so the best fit
+// is in the request's own class or else the smallest of the lowest
+// non-empty class above it.
+static Block* find_best_fit(ListHeap* heap, size_t size) {
+    int cls = size_class(size);
+
+    Block* best = tree_best_fit(heap->size_trees[cls], size);
+    if (best) {
+        return best;
+    }
+    uint64_t above = cls + 1 < NUM_SIZE_CLASSES ? heap->free_list_bitmap & (~0ULL << (cls + 1)) : 0;
+    return above ? tree_best_fit(heap->size_trees[__builtin_ctzll(above)], 0) : NULL;
+}
 
-            current->is_free = 1;
+// Finds a free block with at least `size` bytes under the heap's placement
+// policy. For class fit, any block in a class above the one `size` rounds up
+// to is guaranteed to fit, so the head of the first non-empty such class is
+// taken in O(1). Only when all of those are empty is the request's own class
+// scanned for a block that happens to be big enough.
+static Block* find_free_block(ListHeap* heap, size_t size) {
+    if (heap->placement == MEM_PLACE_FIRST_FIT) {
+        return find_in_address_order(heap->head_block, NULL, size);
+    }
+    if (heap->placement == MEM_PLACE_NEXT_FIT) {
+        return find_next_fit(heap, size);
+    }
+    if (heap->placement == MEM_PLACE_BEST_FIT) {
+        return find_best_fit(heap, size);
+    }
 
-            // Attempt to coalesce adjacent free blocks
-            Block* next_block = current->next;
-            while (next_block != NULL && next_block->is_free) {
-                current->size += next_block->size;
-                current->next = next_block->next;
-                free(next_block);
-                next_block = current->next;
-            }
+    int cls = size_class(size);
+    int fit_cls = size_class_fit(size);
 
-            #ifdef DEBUG
-            printf("Freed block at %p\n", ptr);
-            #endif
+    uint64_t candidates = fit_cls < NUM_SIZE_CLASSES ? heap->free_list_bitmap & (~0ULL << fit_cls) : 0;
+    if (candidates) {
+        return heap->free_lists[__builtin_ctzll(candidates)];
+    }
 
-            pthread_mutex_unlock(&memory_mutex);
-            return;
+    if (fit_cls != cls) {
+        for (Block* current = heap->free_lists[cls]; current != NULL; current = current->free_next) {
+            if (current->size >= size) {
+                return current;
+            }
         }
-        current = current->next;
     }
+    return NULL;
+}
 
-    fprintf(stderr, "Warning: Pointer %p not found in the memory pool.\n", ptr);
-    pthread_mutex_unlock(&memory_mutex);
+// Home slot of a pointer in the block map (Fibonacci hashing)
+static size_t block_map_slot(ListHeap* heap, void* ptr) {
+    uint64_t hash = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash >> 32) & (heap->map_capacity - 1);
 }
 
-// Resizes a previously allocated block of memory
-void* mem_resize(void* ptr, size_t size) {
-    pthread_mutex_lock(&memory_mutex);
+// Rehashes the block map into a table of `capacity` slots
+static int block_map_rehash(ListHeap* heap, size_t capacity) {
+    Block** old_map = heap->block_map;
+    size_t old_capacity = heap->map_capacity;
 
-    if (!ptr) {
-        void* new_ptr = mem_alloc(size);
-        pthread_mutex_unlock(&memory_mutex);
-        return new_ptr;
+    Block** new_map = (Block**)calloc(capacity, sizeof(Block*));
+    if (!new_map) {
+        return -1;
     }
 
-    Block* block = head_block;
-    while (block != NULL) {
-        if (block->ptr == ptr) {
-            if (block->size >= size) {
-                pthread_mutex_unlock(&memory_mutex);
-                return ptr;
-            } else {
-                void* new_ptr = mem_alloc(size);
-                if (new_ptr) {
-                    memcpy(new_ptr, ptr, block->size);
-                    mem_free(ptr);
-                }
-                pthread_mutex_unlock(&memory_mutex);
-                return new_ptr;
+    heap->block_map = new_map;
+    heap->map_capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_map[i]) {
+            size_t slot = block_map_slot(heap, old_map[i]->ptr);
+            while (new_map[slot]) {
+                slot = (slot + 1) & (capacity - 1);
             }
+            new_map[slot] = old_map[i];
+        }
+    }
+    free(old_map);
+    return 0;
+}
+
+// Registers a block under its pointer, growing the table at half load
+static int block_map_insert(ListHeap* heap, Block* block) {
+    if ((heap->map_count + 1) * 2 > heap->map_capacity) {
+        if (block_map_rehash(heap, heap->map_capacity * 2) != 0) {
+            return -1;
         }
-        block = block->next;
     }
 
-    fprintf(stderr, "Warning: Pointer %p not found for resizing.\n", ptr);
-    pthread_mutex_unlock(&memory_mutex);
+    size_t slot = block_map_slot(heap, block->ptr);
+    while (heap->block_map[slot]) {
+        slot = (slot + 1) & (heap->map_capacity - 1);
+    }
+    heap->block_map[slot] = block;
+    heap->map_count++;
+    return 0;
+}
+
+// Looks up the block that starts at `ptr`
+static Block* find_block(ListHeap* heap, void* ptr) {
+    size_t slot = block_map_slot(heap, ptr);
+    while (heap->block_map[slot]) {
+        if (heap->block_map[slot]->ptr == ptr) {
+            return heap->block_map[slot];
+        }
+        slot = (slot + 1) & (heap->map_capacity - 1);
+    }
     return NULL;
 }
 
-// Deinitializes the memory pool and frees all associated resources
-void mem_deinit() {
-    pthread_mutex_lock(&memory_mutex);
+// Removes a block from the map, shifting later entries of the probe run back
+// so that lookups never stop at the hole
+static void block_map_remove(ListHeap* heap, Block* block) {
+    size_t mask = heap->map_capacity - 1;
+    size_t hole = block_map_slot(heap, block->ptr);
+    while (heap->block_map[hole] != block) {
+        hole = (hole + 1) & mask;
+    }
+
+    size_t slot = hole;
+    for (;;) {
+        slot = (slot + 1) & mask;
+        Block* entry = heap->block_map[slot];
+        if (!entry) {
+            break;
+        }
+        size_t home = block_map_slot(heap, entry->ptr);
+        // Move the entry into the hole unless its home lies cyclically in (hole, slot]
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            heap->block_map[hole] = entry;
+            hole = slot;
+        }
+    }
+    heap->block_map[hole] = NULL;
+    heap->map_count--;
+}
+
+static void* list_create(void* base, size_t size) {
+    ListHeap* heap = (ListHeap*)calloc(1, sizeof(ListHeap));
+    if (!heap) {
+        return NULL;
+    }
+
+    heap->head_block = (Block*)malloc(sizeof(Block));
+    heap->block_map = (Block**)calloc(BLOCK_MAP_MIN_CAPACITY, sizeof(Block*));
+    if (!heap->head_block || !heap->block_map) {
+        free(heap->head_block);
+        free(heap->block_map);
+        free(heap);
+        return NULL;
+    }
+    heap->map_capacity = BLOCK_MAP_MIN_CAPACITY;
+    heap->size = size;
+
+    heap->head_block->size = size;
+    heap->head_block->is_free = 1;
+    heap->head_block->ptr = base;
+    heap->head_block->next = NULL;
+    heap->head_block->prev = NULL;
+    free_list_insert(heap, heap->head_block);
+    block_map_insert(heap, heap->head_block);
+
+    return heap;
+}
 
-    free(memory_pool);
-    memory_pool = NULL;
+static void list_destroy(void* handle) {
+    ListHeap* heap = (ListHeap*)handle;
 
-    Block* current = head_block;
+    Block* current = heap->head_block;
     while (current != NULL) {
         Block* next = current->next;
         free(current);
         current = next;
     }
+    free(heap->block_map);
+    free(heap);
+}
+
+// Merges the block after `block` into it. Neither may be on the free lists.
+static void list_merge_next(ListHeap* heap, Block* block) {
+    Block* next_block = block->next;
+    if (heap->rover == next_block) {
+        heap->rover = block;
+    }
+    block_map_remove(heap, next_block);
+    block->size += next_block->size;
+    block->next = next_block->next;
+    if (block->next) {
+        block->next->prev = block;
+    }
+    free(next_block);
+}
+
+// Cuts `block` down to `size` bytes; the rest becomes a new free block on
+// the free lists. Returns 0 on success, -1 if the metadata allocation failed.
+static int list_split(ListHeap* heap, Block* block, size_t size) {
+    Block* new_block = (Block*)malloc(sizeof(Block));
+    if (!new_block) {
+        perror("New block metadata allocation failed");
+        return -1;
+    }
+
+    new_block->size = block->size - size;
+    new_block->is_free = 1;
+    new_block->ptr = (char*)block->ptr + size;
+    new_block->next = block->next;
+    new_block->prev = block;
+    if (block_map_insert(heap, new_block) != 0) {
+        perror("Block map allocation failed");
+        free(new_block);
+        return -1;
+    }
+    free_list_insert(heap, new_block);
+
+    if (block->next) {
+        block->next->prev = new_block;
+    }
+    block->size = size;
+    block->next = new_block;
+    return 0;
+}
+
+static void* list_alloc_aligned(void* handle, size_t size, size_t align) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    // Zero-byte requests still take one byte so that every block has a
+    // distinct pointer to be looked up by
+    if (size == 0) {
+        size = 1;
+    }
+
+    // Blocks usually start aligned already, as every request is rounded to
+    // the pool's alignment. Failing that, any block of size + align - 1
+    // bytes fits the request whatever padding it needs.
+    Block* current = find_free_block(heap, size);
+    if (current && (-(uintptr_t)current->ptr & (align - 1)) > current->size - size) {
+        current = find_free_block(heap, size + align - 1);
+    }
+    if (!current) {
+        return NULL;  // Allocation failed
+    }
+
+    free_list_remove(heap, current);
+
+    size_t pad = -(uintptr_t)current->ptr & (align - 1);
+    if (pad) {
+        // The padding stays behind as a free block of its own
+        if (list_split(heap, current, pad) != 0) {
+            free_list_insert(heap, current);
+            return NULL;
+        }
+        Block* rest = current->next;
+        free_list_remove(heap, rest);
+        free_list_insert(heap, current);
+        current = rest;
+    }
+
+    if (current->size > size && list_split(heap, current, size) != 0) {
+        if (pad) {
+            // Merge the block back into the padding so no two free blocks are adjacent
+            current = current->prev;
+            free_list_remove(heap, current);
+            list_merge_next(heap, current);
+        }
+        free_list_insert(heap, current);
+        return NULL;
+    }
+    current->is_free = 0;
+    heap->used_blocks++;
+    list_note_peak(heap);
+    heap->rover = current->next;
+
+    return current->ptr;
+}
+
+static void* list_alloc(void* handle, size_t size) {
+    return list_alloc_aligned(handle, size, 1);
+}
+
+// Allocates the whole run as one block, then cuts it into `count` blocks.
+// Should the metadata for a cut run out, the last block keeps the rest of
+// the run and fewer blocks are returned.
+static size_t list_alloc_run(void* handle, size_t size, size_t count, size_t align, void** ptrs) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    if (size == 0) {
+        size = 1;
+    }
+    if (count == 0 || size > heap->size / count) {
+        return 0;
+    }
+    char* run = (char*)list_alloc_aligned(handle, size * count, align > 1 ? align : 1);
+    if (!run) {
+        return 0;
+    }
+
+    Block* current = find_block(heap, run);
+    size_t done = 1;
+    ptrs[0] = run;
+    for (; done < count; done++) {
+        Block* piece = (Block*)malloc(sizeof(Block));
+        if (!piece) {
+            break;
+        }
+        piece->size = current->size - size;
+        piece->is_free = 0;
+        piece->ptr = (char*)current->ptr + size;
+        piece->next = current->next;
+        piece->prev = current;
+        if (block_map_insert(heap, piece) != 0) {
+            free(piece);
+            break;
+        }
+        if (current->next) {
+            current->next->prev = piece;
+        }
+        current->size = size;
+        current->next = piece;
+        current = piece;
+        ptrs[done] = piece->ptr;
+    }
+    heap->used_blocks += done - 1;
+    return done;
+}
+
+// Merges the free blocks that follow `block` into it. The merged blocks are
+// taken off the free lists; `block` itself must not be on them.
+static void list_absorb_next(ListHeap* heap, Block* block) {
+    while (block->next != NULL && block->next->is_free) {
+        free_list_remove(heap, block->next);
+        list_merge_next(heap, block);
+    }
+}
+
+// Returns an allocated block to the free lists, merging it with its free
+// neighbours on both sides. Free blocks are merged on every free, so there
+// is at most one on either side and the back link finds the one below in O(1).
+static int list_free(void* handle, void* ptr) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    Block* current = find_block(heap, ptr);
+    if (!current) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (current->is_free) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+
+    current->is_free = 1;
+    heap->used_blocks--;
+    list_absorb_next(heap, current);
+    if (current->prev && current->prev->is_free) {
+        current = current->prev;
+        free_list_remove(heap, current);
+        list_merge_next(heap, current);
+    }
+    free_list_insert(heap, current);
+    return MEM_OK;
+}
+
+// Grows a block into the free block after it, or shrinks it by splitting off
+// its tail, without moving it
+static int list_resize(void* handle, void* ptr, size_t size) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    Block* current = find_block(heap, ptr);
+    if (!current) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (current->is_free) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+
+    if (size > current->size) {
+        Block* next_block = current->next;
+        if (!next_block || !next_block->is_free || current->size + next_block->size < size) {
+            return MEM_ERR_NO_ROOM;
+        }
+        list_absorb_next(heap, current);
+    }
+
+    if (current->size > size) {
+        // Give the tail back, merged with whatever free space follows it.
+        // If that fails the block is merely larger than asked for.
+        if (list_split(heap, current, size) == 0) {
+            Block* tail = current->next;
+            free_list_remove(heap, tail);
+            list_absorb_next(heap, tail);
+            free_list_insert(heap, tail);
+        }
+    }
+    list_note_peak(heap);
+    return MEM_OK;
+}
+
+static int list_block_size(void* handle, void* ptr, size_t* size) {
+    Block* block = find_block((ListHeap*)handle, ptr);
+    if (!block) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (block->is_free) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    *size = block->size;
+    return MEM_OK;
+}
+
+// Block metadata lives outside the pool, so free blocks are free end to end
+static void list_free_runs(void* handle, mem_run_fn fn, void* ctx) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    for (uint64_t classes = heap->free_list_bitmap; classes; classes &= classes - 1) {
+        tree_for_each(heap->size_trees[__builtin_ctzll(classes)], fn, ctx);
+        for (Block* block = heap->free_lists[__builtin_ctzll(classes)]; block != NULL; block = block->free_next) {
+            fn(block->ptr, block->size, ctx);
+        }
+    }
+}
+
+// The block list is kept in address order and covers the whole heap
+static void list_walk(void* handle, mem_block_fn fn, void* ctx) {
+    for (Block* block = ((ListHeap*)handle)->head_block; block != NULL; block = block->next) {
+        fn(block->ptr, block->size, block->is_free, ctx);
+    }
+}
+
+// Switches the policy, moving the free blocks over if it keeps them elsewhere
+static void list_set_placement(void* handle, mem_placement_t placement) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    for (Block* block = heap->head_block; block != NULL; block = block->next) {
+        if (block->is_free) {
+            free_list_remove(heap, block);
+        }
+    }
+    heap->placement = placement;
+    heap->rover = NULL;
+    for (Block* block = heap->head_block; block != NULL; block = block->next) {
+        if (block->is_free) {
+            free_list_insert(heap, block);
+        }
+    }
+}
+
+static void list_stats(void* handle, mem_backend_stats* stats) {
+    ListHeap* heap = (ListHeap*)handle;
+
+    stats->used_bytes = heap->size - heap->free_bytes;
+    stats->used_blocks = heap->used_blocks;
+    stats->free_bytes = heap->free_bytes;
+    stats->free_blocks = heap->free_blocks;
+    stats->peak_used_bytes = heap->peak_used;
+
+    // The largest free block is in the highest non-empty class, the
+    // rightmost one if the class is a tree
+    stats->largest_free = 0;
+    if (heap->free_list_bitmap) {
+        int cls = 63 - __builtin_clzll(heap->free_list_bitmap);
+        for (Block* block = heap->size_trees[cls]; block != NULL; block = block->tree_right) {
+            stats->largest_free = block->size;
+        }
+        for (Block* block = heap->free_lists[cls]; block != NULL; block = block->free_next) {
+            if (block->size > stats->largest_free) {
+                stats->largest_free = block->size;
+            }
+        }
+    }
+}
+
+const mem_backend mem_list_backend = {
+    .name = "list",
+    .create = list_create,
+    .set_placement = list_set_placement,
+    .destroy = list_destroy,
+    .alloc = list_alloc,
+    .alloc_aligned = list_alloc_aligned,
+    .alloc_run = list_alloc_run,
+    .free = list_free,
+    .resize = list_resize,
+    .block_size = list_block_size,
+    .free_runs = list_free_runs,
+    .walk = list_walk,
+    .stats = list_stats,
+};
+
+// The pool is split into equally sized arenas, each with its own lock and
+// backend state, so threads working in different arenas never contend.
+// Every block lives entirely inside one arena, which is found from the
+// block's address alone.
+#define MAX_ARENAS 64
+#define POOL_ALIGN 4096 // Alignment of the pool memory
+#define HUGE_PAGE_SIZE ((size_t)2 << 20) // Alignment of mmap'd pools, the x86-64 huge page size
+
+// A growable pool maps extra chunks when no arena can satisfy a request. Each
+// chunk is managed like an arena, with its own lock and backend heap, but is
+// shared by all threads. Chunks are never moved or released before the pool
+// is destroyed, so pointers into them stay valid. Every chunk is at least
+// twice as large as the one before, so there are only ever a few of them.
+#define MAX_CHUNKS 48
+#define CHUNK_SLACK 4096 // Room for backend metadata and padding beyond the request
+#define ARENA_ALIGN 64  // Alignment of every arena boundary
+#define DEFAULT_ALIGNMENT _Alignof(max_align_t) // Alignment of every block unless configured otherwise
+
+typedef struct Arena {
+    pthread_mutex_t lock; // Protects `heap`, unless `mutex` says otherwise
+    void* heap;           // Backend state for this arena
+    char* base;           // Start of the arena's slice of the pool
+    size_t size;          // Size of the slice
+    long long purge_deadline; // Coarse-clock ms at which freed memory is purged, 0 if none is pending
+    pthread_mutex_t* mutex;   // The lock taken: &lock, or the one in the shared memory of a shared pool
+    #ifdef MEM_LOCK_STATS
+    mem_lock_stats_t lock_stats[MEM_LOCK_OPS]; // Protected by `mutex` like the heap
+    long long held_since; // When the current holder acquired the lock
+    int held_op;          // What the current holder is doing, a mem_lock_op_t
+    #endif
+} Arena;
+
+static inline long long monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    head_block = NULL;
-    memory_pool_size = 0;
+// The lock of a shared pool is robust: when a process dies holding it, the
+// next process to take it is told so and rebuilds the heap from its block
+// headers, which may have been left halfway through a change
+static void arena_recover(Arena* arena) {
+    if (!mem_tags_backend.attach(arena->base, arena->size, 1)) {
+        fprintf(stderr, "Error: A process died holding the lock of a shared memory pool and left it damaged.\n");
+    }
+    pthread_mutex_consistent(arena->mutex);
+}
+
+// Lock instrumentation, compiled in with -DMEM_LOCK_STATS. Every arena lock
+// acquisition is attributed to the operation taking it. The wait is only
+// timed when the lock was not free at once, the hold time always. An arena's
+// counters are only touched with its lock held, so they need no atomics.
+// Without MEM_LOCK_STATS these are plain pthread calls.
+#ifdef MEM_LOCK_STATS
+static inline void arena_lock(Arena* arena, mem_lock_op_t op) {
+    long long wait = 0;
+    int status = pthread_mutex_trylock(arena->mutex);
+    int contended = status != 0 && status != EOWNERDEAD;
+    if (contended) {
+        long long start = monotonic_ns();
+        status = pthread_mutex_lock(arena->mutex);
+        wait = monotonic_ns() - start;
+    }
+    if (status == EOWNERDEAD) {
+        arena_recover(arena);
+    }
+    mem_lock_stats_t* stats = &arena->lock_stats[op];
+    stats->acquires++;
+    stats->contended += contended;
+    stats->wait_ns += wait;
+    if ((uint64_t)wait > stats->max_wait_ns) {
+        stats->max_wait_ns = wait;
+    }
+    arena->held_op = op;
+    arena->held_since = monotonic_ns();
+}
+
+static inline void arena_unlock(Arena* arena) {
+    mem_lock_stats_t* stats = &arena->lock_stats[arena->held_op];
+    long long hold = monotonic_ns() - arena->held_since;
+    stats->hold_ns += hold;
+    if ((uint64_t)hold > stats->max_hold_ns) {
+        stats->max_hold_ns = hold;
+    }
+    pthread_mutex_unlock(arena->mutex);
+}
+#else
+static inline void arena_lock(Arena* arena, mem_lock_op_t op) {
+    (void)op;
+    if (pthread_mutex_lock(arena->mutex) == EOWNERDEAD) {
+        arena_recover(arena);
+    }
+}
+
+static inline void arena_unlock(Arena* arena) {
+    pthread_mutex_unlock(arena->mutex);
+}
+#endif
+
+// Returning free memory to the OS. The whole pages inside free runs are
+// handed back with madvise; when they are written again the kernel maps in
+// fresh zero pages (MADV_DONTNEED), or keeps the old ones if it has not
+// reclaimed them yet (MADV_FREE), so reuse needs no bookkeeping. Automatic
+// purging is driven by frees: the first free into an arena after a purge
+// arms a deadline purge_decay_ms ahead, and the first free past it purges the
+// arena. There is no background thread, so an idle pool is purged by mem_trim.
+typedef struct PurgeState {
+    size_t threshold; // Smallest run worth purging
+    size_t page;      // Page size
+    int advice;       // MADV_DONTNEED or MADV_FREE
+    size_t purged;    // Bytes handed back so far
+} PurgeState;
+
+// Operation counts for mem_stats. Every thread adds to one of a few shards,
+// each on its own cache line and picked once per thread, so that counting
+// does not have all threads contend on one line; mem_stats adds them up.
+// Occupancy is counted by the backends instead, under the arena locks.
+#define STAT_SHARDS 16
+
+typedef struct StatShard {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t resizes;
+    uint64_t failed_allocs;
+    char pad[64 - 4 * sizeof(uint64_t)];
+} StatShard;
+
+#define STAT_ADD(pool, field, n) __atomic_fetch_add(&stat_shard(pool)->field, (n), __ATOMIC_RELAXED)
+
+// Latency histograms, one per StatShard and picked the same way. They are
+// only allocated for pools created with a latency_clock.
+typedef struct LatencyShard {
+    uint64_t counts[MEM_OPS][MEM_HIST_SIZE_CLASSES][MEM_HIST_BUCKETS];
+} LatencyShard;
+
+// Per-thread caches. When enabled, every block handed out by the front end
+// is preceded by a CacheHeader recording its usable size, so mem_free can
+// tell a small block's class without looking it up under an arena lock.
+// Requests up to tcache_max_size are rounded up to a multiple of
+// TCACHE_GRANULE and freed blocks of that class are kept in the freeing
+// thread's cache; the cache is refilled from and flushed to the arenas in
+// batches of tcache_batch blocks, taking each arena lock once per batch.
+#define TCACHE_GRANULE 16
+#define TCACHE_MAX_SIZE 1024
+#define TCACHE_NUM_CLASSES (TCACHE_MAX_SIZE / TCACHE_GRANULE)
+#define TCACHE_DEFAULT_MAX_SIZE 256
+#define TCACHE_LIVE ((size_t)0x4C495645u)    // Header tag of a block owned by the caller
+#define TCACHE_CACHED ((size_t)0x43414348u)  // Header tag of a block sitting in a thread cache
+#define TCACHE_ALIGNED ((size_t)0x414C4E44u) // Header tag of a mem_alloc_aligned block, never cached
+
+// Sits right in front of the payload. With a default alignment above 16 the
+// payload starts `alignment` bytes into the backend block and the header
+// occupies the end of that gap.
+typedef struct CacheHeader {
+    size_t size; // Usable bytes after the header; for TCACHE_ALIGNED, the payload's offset into its backend block
+    size_t tag;  // TCACHE_LIVE, TCACHE_CACHED or TCACHE_ALIGNED
+} CacheHeader;
+
+typedef struct CacheBin {
+    size_t count;
+    CacheHeader** entries; // tcache_count slots
+} CacheBin;
+
+// One thread's cache for one pool. The pool keeps all of its caches in a
+// list so that destroying the pool frees them along with it.
+typedef struct ThreadCache {
+    mem_pool_t* pool;
+    struct ThreadCache* prev;
+    struct ThreadCache* next;
+    CacheBin bins[TCACHE_NUM_CLASSES];
+} ThreadCache;
+
+// A memory pool and everything needed to allocate from it. The functions
+// without a pool argument operate on default_pool, set up by mem_init_ex.
+// A file-backed pool starts with this header, on a page of its own, followed
+// by the pool memory. It runs the tags backend, whose metadata lives in the
+// pool as offsets, so a later process can map the file and carry on. Roots
+// are offsets from the start of the pool memory, 0 meaning none. A shared
+// pool has the same layout in shared memory, used by several processes at
+// once under the process-shared lock in the header.
+#define FILE_MAGIC 0x314C4F4F504D454DULL // "MEMPOOL1"
+#define FILE_VERSION 1
+#define FILE_HEADER_SIZE 4096
+#define FILE_ROOTS 16
+#define FILE_ROOT_NAME 48
+
+typedef struct PoolFileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t clean; // 1 after a clean shutdown, 0 while a process has the pool open
+    uint64_t size;  // Size of the pool memory
+    uint64_t base;  // Address the pool memory was last mapped at
+    struct {
+        char name[FILE_ROOT_NAME];
+        uint64_t offset;
+    } roots[FILE_ROOTS];
+    uint32_t shared;      // 1 for a shared pool
+    pthread_mutex_t lock; // Process-shared and robust; the arena lock of a shared pool
+} PoolFileHeader;
+
+struct mem_pool {
+    char* memory;                    // Start of the pool
+    PoolFileHeader* file;            // Header of the backing file, NULL unless the pool is file-backed
+    int file_fd;                     // Holds the lock on the pool file while the pool is open, -1 if none
+    size_t size;                     // Size of the pool in bytes
+    size_t mapped_size;              // Length of the mapping if the pool was mmap'd, 0 if it came from the heap
+    const mem_backend* backend;      // Backend managing every arena
+    unsigned long id;                // Never reused, so thread-local state can tell pools apart
+
+    Arena arenas[MAX_ARENAS];
+    size_t arena_count;
+    size_t arena_span;               // Size of every arena but the last, which also takes the remainder
+    mem_arena_policy_t arena_policy;
+    mem_placement_t placement;       // Placement policy handed to every backend heap
+    size_t alignment;                // Alignment of every block handed out, 0 to leave it to the backend
+
+    size_t purge_threshold;          // Free runs this large are purged automatically, 0 to never purge
+    long long purge_decay_ms;        // Delay between a free and the purge that follows it
+    int purge_advice;                // MADV_DONTNEED or MADV_FREE
+
+    Arena chunks[MAX_CHUNKS];        // Extra memory mapped by a growable pool
+    size_t chunk_count;              // Published with release ordering once a chunk is ready
+    size_t max_size;                 // Growth cap on size plus all chunks, 0 if the pool cannot grow
+    size_t grown_size;               // size plus the size of every chunk
+    size_t next_chunk_size;          // Size of the next chunk, doubled after each one
+    unsigned int map_flags;          // MEM_MAP_* flags the chunks are mapped with
+    pthread_mutex_t grow_lock;       // Serializes adding chunks
+
+    StatShard stats[STAT_SHARDS];    // Operation counts, see StatShard
+    LatencyShard* latency;           // STAT_SHARDS latency histograms, NULL if latencies are not recorded
+    mem_latency_clock_t latency_clock;
+
+    size_t tcache_count;             // Blocks cached per class and thread, 0 if disabled
+    size_t tcache_batch;             // Blocks moved per refill or flush
+    size_t tcache_max_size;          // Largest request served from the caches
+    size_t tcache_header_size;       // Bytes in front of each payload, at least sizeof(CacheHeader)
+    pthread_key_t tcache_key;        // Calling thread's ThreadCache; flushes it at thread exit
+    pthread_mutex_t tcache_lock;     // Protects `tcaches`
+    ThreadCache* tcaches;            // Every thread's cache for this pool
+};
+
+static mem_pool_t default_pool_storage;
+static mem_pool_t* default_pool = NULL; // &default_pool_storage between mem_init_ex and mem_deinit
 
-    pthread_mutex_unlock(&memory_mutex);
-    pthread_mutex_destroy(&memory_mutex);
+static unsigned long next_pool_id = 0;
+
+static unsigned int next_thread = 0;              // Round-robin counter for new threads
+static __thread unsigned int thread_ordinal = 0;  // 1 + the calling thread's position in creation order, 0 if unset
+
+static unsigned int next_stat_shard = 0;
+static __thread unsigned int stat_shard_index = 0; // 1 + the calling thread's StatShard, 0 if unset
+
+static inline unsigned int stat_shard_slot() {
+    if (!stat_shard_index) {
+        stat_shard_index = __atomic_add_fetch(&next_stat_shard, 1, __ATOMIC_RELAXED);
+    }
+    return (stat_shard_index - 1) % STAT_SHARDS;
+}
+
+static inline StatShard* stat_shard(mem_pool_t* pool) {
+    return &pool->stats[stat_shard_slot()];
+}
+
+// Nanoseconds per time stamp counter tick, measured once against CLOCK_MONOTONIC
+static double tsc_ns_per_tick = 1.0;
+static pthread_once_t tsc_once = PTHREAD_ONCE_INIT;
+
+#ifdef HAVE_TSC
+static void tsc_calibrate() {
+    long long start_ns = monotonic_ns();
+    unsigned long long start = __rdtsc();
+    struct timespec pause = {0, 5000000};
+    nanosleep(&pause, NULL);
+    long long elapsed_ns = monotonic_ns() - start_ns;
+    unsigned long long elapsed = __rdtsc() - start;
+    if (elapsed > 0 && elapsed_ns > 0) {
+        tsc_ns_per_tick = (double)elapsed_ns / (double)elapsed;
+    }
+}
+#endif
+
+static inline uint64_t latency_now(mem_pool_t* pool) {
+    #ifdef HAVE_TSC
+    if (pool->latency_clock == MEM_CLOCK_TSC) {
+        return __rdtsc();
+    }
+    #endif
+    return (uint64_t)monotonic_ns();
+}
+
+// Starts timing an operation, if the pool records latencies
+static inline uint64_t latency_start(mem_pool_t* pool) {
+    return pool->latency ? latency_now(pool) : 0;
+}
+
+// Records the latency of an operation on a `size`-byte block started at `start`
+static inline void latency_record(mem_pool_t* pool, mem_op_t op, size_t size, uint64_t start) {
+    if (!pool->latency) {
+        return;
+    }
+    uint64_t elapsed = latency_now(pool) - start;
+    if (pool->latency_clock == MEM_CLOCK_TSC) {
+        elapsed = (uint64_t)((double)elapsed * tsc_ns_per_tick);
+    }
+    uint64_t* count = &pool->latency[stat_shard_slot()].counts[op][hist_size_class(size)][hist_bucket(elapsed)];
+    __atomic_fetch_add(count, 1, __ATOMIC_RELAXED);
+}
+
+// Returns the arena the calling thread allocates from first
+static Arena* home_arena(mem_pool_t* pool) {
+    if (pool->arena_count == 1) {
+        return &pool->arenas[0];
+    }
+    if (pool->arena_policy == MEM_ARENA_PER_CPU) {
+        int cpu = sched_getcpu();
+        return &pool->arenas[(cpu < 0 ? 0 : (size_t)cpu) % pool->arena_count];
+    }
+    if (!thread_ordinal) {
+        thread_ordinal = __atomic_add_fetch(&next_thread, 1, __ATOMIC_RELAXED);
+    }
+    return &pool->arenas[(thread_ordinal - 1) % pool->arena_count];
+}
+
+// Returns the arena or chunk whose memory contains `ptr`, or NULL if `ptr` is outside the pool
+static Arena* arena_of(mem_pool_t* pool, void* ptr) {
+    if ((char*)ptr >= pool->memory && (char*)ptr < pool->memory + pool->size) {
+        size_t index = (size_t)((char*)ptr - pool->memory) / pool->arena_span;
+        return &pool->arenas[index < pool->arena_count ? index : pool->arena_count - 1];
+    }
+
+    size_t chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < chunk_count; i++) {
+        Arena* chunk = &pool->chunks[i];
+        if ((char*)ptr >= chunk->base && (char*)ptr < chunk->base + chunk->size) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+static Arena* pool_grow(mem_pool_t* pool, size_t size, size_t align, size_t seen_chunks);
+
+// Hands the whole pages of one free run back to the OS
+static void purge_run(void* start, size_t size, void* ctx) {
+    PurgeState* state = (PurgeState*)ctx;
+    if (size < state->threshold) {
+        return;
+    }
+    uintptr_t from = ((uintptr_t)start + state->page - 1) & ~(uintptr_t)(state->page - 1);
+    uintptr_t to = ((uintptr_t)start + size) & ~(uintptr_t)(state->page - 1);
+    if (to > from && madvise((void*)from, to - from, state->advice) == 0) {
+        state->purged += to - from;
+    }
+}
+
+// Purges the free runs of at least `threshold` bytes in `arena`. The arena
+// lock must be held. Returns the number of bytes handed back.
+static size_t arena_purge(mem_pool_t* pool, Arena* arena, size_t threshold) {
+    PurgeState state = {threshold, (size_t)sysconf(_SC_PAGESIZE), pool->purge_advice, 0};
+    pool->backend->free_runs(arena->heap, purge_run, &state);
+    arena->purge_deadline = 0;
+    return state.purged;
+}
+
+// Milliseconds on a clock that is cheap to read
+static long long purge_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Called after every free into `arena`, with the arena lock held
+static inline void arena_freed(mem_pool_t* pool, Arena* arena) {
+    if (!pool->purge_threshold) {
+        return;
+    }
+    long long now = purge_clock_ms();
+    if (!arena->purge_deadline) {
+        arena->purge_deadline = now + pool->purge_decay_ms;
+    }
+    if (now >= arena->purge_deadline) {
+        arena_purge(pool, arena, pool->purge_threshold);
+    }
+}
+
+// Rounds a request up to a multiple of the pool's alignment, so that the
+// block placed after it starts aligned as well rather than behind padding
+static inline size_t pool_round(mem_pool_t* pool, size_t size) {
+    if (pool->alignment > 1 && size <= SIZE_MAX - pool->alignment) {
+        return (size + pool->alignment - 1) & ~(pool->alignment - 1);
+    }
+    return size;
+}
+
+// Allocates from one arena's backend; an `align` of 0 or 1 asks for none.
+// The arena lock must be held.
+static void* backend_alloc(mem_pool_t* pool, Arena* arena, size_t size, size_t align) {
+    if (align > 1) {
+        if (align == pool->alignment) {
+            size = pool_round(pool, size);
+        }
+        return pool->backend->alloc_aligned(arena->heap, size, align);
+    }
+    return pool->backend->alloc(arena->heap, size);
+}
+
+// Allocates from the calling thread's home arena, falling back to the others
+// in turn when it cannot satisfy the request
+static void* arena_alloc(mem_pool_t* pool, size_t size, size_t align) {
+    Arena* home = home_arena(pool);
+    size_t start = (size_t)(home - pool->arenas);
+
+    for (size_t i = 0; i < pool->arena_count; i++) {
+        Arena* arena = &pool->arenas[(start + i) % pool->arena_count];
+        arena_lock(arena, MEM_LOCK_ALLOC);
+        void* ptr = backend_alloc(pool, arena, size, align);
+        arena_unlock(arena);
+        if (ptr) {
+            return ptr;
+        }
+    }
+    if (!pool->max_size) {
+        return NULL;
+    }
+
+    // Then the chunks of a growable pool, newest and largest first, and
+    // finally a new chunk
+    size_t chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    for (;;) {
+        for (size_t i = chunk_count; i-- > 0;) {
+            Arena* chunk = &pool->chunks[i];
+            arena_lock(chunk, MEM_LOCK_ALLOC);
+            void* ptr = backend_alloc(pool, chunk, size, align);
+            arena_unlock(chunk);
+            if (ptr) {
+                return ptr;
+            }
+        }
+
+        Arena* chunk = pool_grow(pool, size, align, chunk_count);
+        if (!chunk) {
+            return NULL;
+        }
+        arena_lock(chunk, MEM_LOCK_ALLOC);
+        void* ptr = backend_alloc(pool, chunk, size, align);
+        arena_unlock(chunk);
+        if (ptr) {
+            return ptr;
+        }
+        // Other threads took the new chunk's space first; look again
+        chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    }
+}
+
+// Returns a block to the arena that owns it. With `size`, the block's usable
+// size is read under the same lock first, for the latency histograms.
+static int arena_free(mem_pool_t* pool, void* ptr, size_t* size) {
+    Arena* arena = arena_of(pool, ptr);
+    if (!arena) {
+        return MEM_ERR_NOT_FOUND;
+    }
+
+    arena_lock(arena, MEM_LOCK_FREE);
+    if (size && pool->backend->block_size(arena->heap, ptr, size) != MEM_OK) {
+        *size = 0;
+    }
+    int status = pool->backend->free(arena->heap, ptr);
+    if (status == MEM_OK) {
+        arena_freed(pool, arena);
+    }
+    arena_unlock(arena);
+    return status;
+}
+
+// Returns the backend block that holds the payload behind `header`
+static inline void* tcache_block_of(mem_pool_t* pool, CacheHeader* header) {
+    return (char*)(header + 1) - pool->tcache_header_size;
+}
+
+// Returns the header of the payload in a freshly allocated backend block
+static inline CacheHeader* tcache_header_in(mem_pool_t* pool, void* block) {
+    return (CacheHeader*)((char*)block + pool->tcache_header_size) - 1;
+}
+
+// The calling thread's cache of the pool it last used, so the common case of
+// a thread working with one pool skips pthread_getspecific
+static __thread unsigned long tcache_local_id = 0;
+static __thread ThreadCache* tcache_local = NULL;
+
+// Returns the oldest `count` cached blocks of one bin to their arenas,
+// holding each arena lock across consecutive blocks that belong to it
+static void tcache_release(mem_pool_t* pool, CacheBin* bin, size_t count) {
+    Arena* locked = NULL;
+    for (size_t i = 0; i < count; i++) {
+        void* block = tcache_block_of(pool, bin->entries[i]);
+        Arena* arena = arena_of(pool, block);
+        if (arena != locked) {
+            if (locked) {
+                arena_freed(pool, locked);
+                arena_unlock(locked);
+            }
+            arena_lock(arena, MEM_LOCK_FREE);
+            locked = arena;
+        }
+        pool->backend->free(arena->heap, block);
+    }
+    if (locked) {
+        arena_freed(pool, locked);
+        arena_unlock(locked);
+    }
+    bin->count -= count;
+    memmove(bin->entries, bin->entries + count, bin->count * sizeof(CacheHeader*));
+}
+
+// Returns every cached block of `cache` to the pool
+static void tcache_flush_all(ThreadCache* cache) {
+    for (int cls = 0; cls < TCACHE_NUM_CLASSES; cls++) {
+        tcache_release(cache->pool, &cache->bins[cls], cache->bins[cls].count);
+    }
+}
+
+// Unlinks a cache from its pool and frees it; the pool's tcache_lock must be held
+static void tcache_delete(ThreadCache* cache) {
+    mem_pool_t* pool = cache->pool;
+    if (cache->prev) {
+        cache->prev->next = cache->next;
+    } else {
+        pool->tcaches = cache->next;
+    }
+    if (cache->next) {
+        cache->next->prev = cache->prev;
+    }
+    free(cache->bins[0].entries);
+    free(cache);
+}
+
+// Thread exit: hand the cached blocks back so other threads can use them
+static void tcache_thread_exit(void* arg) {
+    ThreadCache* cache = (ThreadCache*)arg;
+    mem_pool_t* pool = cache->pool;
+    tcache_flush_all(cache);
+    pthread_mutex_lock(&pool->tcache_lock);
+    tcache_delete(cache);
+    pthread_mutex_unlock(&pool->tcache_lock);
+}
+
+// Returns the calling thread's cache for `pool`, creating it on first use
+static ThreadCache* tcache_get(mem_pool_t* pool) {
+    if (tcache_local_id == pool->id) {
+        return tcache_local;
+    }
+
+    ThreadCache* cache = (ThreadCache*)pthread_getspecific(pool->tcache_key);
+    if (!cache) {
+        cache = (ThreadCache*)calloc(1, sizeof(ThreadCache));
+        CacheHeader** slots = (CacheHeader**)malloc(TCACHE_NUM_CLASSES * pool->tcache_count * sizeof(CacheHeader*));
+        if (!cache || !slots) {
+            free(cache);
+            free(slots);
+            return NULL;
+        }
+        for (int cls = 0; cls < TCACHE_NUM_CLASSES; cls++) {
+            cache->bins[cls].entries = slots + cls * pool->tcache_count;
+        }
+        cache->pool = pool;
+
+        pthread_mutex_lock(&pool->tcache_lock);
+        cache->next = pool->tcaches;
+        if (cache->next) {
+            cache->next->prev = cache;
+        }
+        pool->tcaches = cache;
+        pthread_mutex_unlock(&pool->tcache_lock);
+        pthread_setspecific(pool->tcache_key, cache);
+    }
+
+    tcache_local_id = pool->id;
+    tcache_local = cache;
+    return cache;
+}
+
+// Allocates a block with a CacheHeader from the arenas
+static void* tcache_pool_alloc(mem_pool_t* pool, size_t size) {
+    void* block = arena_alloc(pool, pool->tcache_header_size + size, pool->alignment);
+    if (!block) {
+        return NULL;
+    }
+    CacheHeader* header = tcache_header_in(pool, block);
+    header->size = size;
+    header->tag = TCACHE_LIVE;
+    return header + 1;
+}
+
+static void* tcache_alloc(mem_pool_t* pool, size_t size) {
+    if (size > pool->tcache_max_size) {
+        return tcache_pool_alloc(pool, size);
+    }
+
+    size_t rounded = size ? (size + TCACHE_GRANULE - 1) & ~(size_t)(TCACHE_GRANULE - 1) : TCACHE_GRANULE;
+    ThreadCache* cache = tcache_get(pool);
+    if (!cache) {
+        return tcache_pool_alloc(pool, rounded);
+    }
+
+    CacheBin* bin = &cache->bins[rounded / TCACHE_GRANULE - 1];
+    if (bin->count == 0) {
+        // Refill a batch of blocks from the home arena under one lock acquisition
+        Arena* arena = home_arena(pool);
+        arena_lock(arena, MEM_LOCK_ALLOC);
+        while (bin->count < pool->tcache_batch) {
+            void* block = backend_alloc(pool, arena, pool->tcache_header_size + rounded, pool->alignment);
+            if (!block) {
+                break;
+            }
+            CacheHeader* header = tcache_header_in(pool, block);
+            header->size = rounded;
+            header->tag = TCACHE_CACHED;
+            bin->entries[bin->count++] = header;
+        }
+        arena_unlock(arena);
+    }
+
+    if (bin->count == 0) {
+        // The home arena is exhausted; memory parked in this thread's other
+        // bins or free in the other arenas may still fit
+        tcache_flush_all(cache);
+        return tcache_pool_alloc(pool, rounded);
+    }
+
+    CacheHeader* header = bin->entries[--bin->count];
+    header->tag = TCACHE_LIVE;
+    return header + 1;
+}
+
+// Allocates a block for mem_alloc_aligned, bypassing the caches. The payload
+// starts `align` bytes into the backend block so the header fits in front.
+static void* tcache_alloc_aligned(mem_pool_t* pool, size_t size, size_t align) {
+    size_t offset = align > sizeof(CacheHeader) ? align : sizeof(CacheHeader);
+    char* block = (char*)arena_alloc(pool, offset + size, align);
+    if (!block) {
+        return NULL;
+    }
+    CacheHeader* header = (CacheHeader*)(block + offset) - 1;
+    header->size = offset;
+    header->tag = TCACHE_ALIGNED;
+    return header + 1;
+}
+
+// Returns the CacheHeader in front of `ptr`, or NULL if `ptr` is outside the pool
+static CacheHeader* tcache_header_of(mem_pool_t* pool, void* ptr) {
+    CacheHeader* header = (CacheHeader*)ptr - 1;
+    if (!arena_of(pool, header) || !arena_of(pool, ptr)) {
+        return NULL;
+    }
+    return header;
+}
+
+// Returns the backend block behind `ptr`, no longer marked as the caller's,
+// for freeing it past the caches; NULL with the reason in *status if `ptr`
+// is not a block the caller holds
+static void* tcache_unwrap(mem_pool_t* pool, void* ptr, int* status) {
+    CacheHeader* header = tcache_header_of(pool, ptr);
+    if (!header || (header->tag != TCACHE_LIVE && header->tag != TCACHE_ALIGNED)) {
+        *status = header && header->tag == TCACHE_CACHED ? MEM_ERR_NOT_ALLOCATED : MEM_ERR_NOT_FOUND;
+        return NULL;
+    }
+    void* block = header->tag == TCACHE_ALIGNED ? (char*)ptr - header->size : tcache_block_of(pool, header);
+    header->tag = 0;
+    return block;
+}
+
+// Returns MEM_OK once the block has been cached or released. With `size`,
+// the block's usable size is stored there, as for arena_free.
+static int tcache_free(mem_pool_t* pool, void* ptr, size_t* size) {
+    CacheHeader* header = tcache_header_of(pool, ptr);
+    if (!header) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (header->tag == TCACHE_CACHED) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    if (header->tag == TCACHE_ALIGNED) {
+        size_t offset = header->size;
+        header->tag = 0;
+        int status = arena_free(pool, (char*)ptr - offset, size);
+        if (size) {
+            *size = *size > offset ? *size - offset : 0;
+        }
+        return status;
+    }
+    if (header->tag != TCACHE_LIVE) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (size) {
+        *size = header->size;
+    }
+
+    ThreadCache* cache = header->size <= pool->tcache_max_size ? tcache_get(pool) : NULL;
+    if (!cache) {
+        header->tag = 0;
+        return arena_free(pool, tcache_block_of(pool, header), NULL);
+    }
+
+    CacheBin* bin = &cache->bins[header->size / TCACHE_GRANULE - 1];
+    if (bin->count == pool->tcache_count) {
+        // Flush the oldest batch so the cache keeps the most recently freed blocks
+        tcache_release(pool, bin, pool->tcache_batch);
+    }
+    header->tag = TCACHE_CACHED;
+    bin->entries[bin->count++] = header;
+    return MEM_OK;
+}
+
+// Maps a backend selector from the public config to its implementation
+static const mem_backend* backend_for(mem_backend_t backend) {
+    switch (backend) {
+    case MEM_BACKEND_TAGS:
+        return &mem_tags_backend;
+    case MEM_BACKEND_BUDDY:
+        return &mem_buddy_backend;
+    case MEM_BACKEND_TLSF:
+        return &mem_tlsf_backend;
+    case MEM_BACKEND_LIST:
+    default:
+        return &mem_list_backend;
+    }
+}
+
+// Destroys the backend heaps and locks of the first `count` arenas
+static void pool_destroy_arenas(mem_pool_t* pool, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        Arena* arena = &pool->arenas[i];
+        pthread_mutex_lock(&arena->lock);
+        if (arena->heap) {
+            pool->backend->destroy(arena->heap);
+            arena->heap = NULL;
+        }
+        pthread_mutex_unlock(&arena->lock);
+        pthread_mutex_destroy(&arena->lock);
+    }
+}
+
+// Destroys the chunks of a growable pool and unmaps them
+static void pool_destroy_chunks(mem_pool_t* pool) {
+    for (size_t i = 0; i < pool->chunk_count; i++) {
+        Arena* chunk = &pool->chunks[i];
+        pool->backend->destroy(chunk->heap);
+        pthread_mutex_destroy(&chunk->lock);
+        munmap(chunk->base, chunk->size);
+    }
+    pool->chunk_count = 0;
+    pthread_mutex_destroy(&pool->grow_lock);
+}
+
+// Gives the pool memory back to wherever it came from
+static void pool_release_memory(mem_pool_t* pool) {
+    if (pool->file) {
+        munmap(pool->file, pool->mapped_size);
+    } else if (pool->mapped_size) {
+        munmap(pool->memory, pool->mapped_size);
+    } else {
+        free(pool->memory);
+    }
+}
+
+// Faults in every page of [mem, mem + len) ahead of use
+static void pool_prefault(char* mem, size_t len) {
+    #ifdef MADV_POPULATE_WRITE
+    if (madvise(mem, len, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+    #endif
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < len; off += page) {
+        ((volatile char*)mem)[off] = 0;
+    }
+}
+
+// Maps the memory for a pool of `size` bytes as selected by MEM_MAP_* `flags`,
+// starting on a huge page boundary. Returns NULL on failure; the length to
+// unmap is stored in *mapped_size.
+static char* pool_map(size_t size, unsigned int flags, size_t* mapped_size) {
+    int populate = (flags & MEM_MAP_POPULATE) ? MAP_POPULATE : 0;
+    size_t len = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+    if (flags & MEM_MAP_HUGETLB) {
+        void* mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+        if (mem != MAP_FAILED) {
+            *mapped_size = len;
+            return (char*)mem;
+        }
+        // No huge pages reserved (vm.nr_hugepages); settle for transparent ones
+        flags |= MEM_MAP_HUGEPAGE;
+    }
+
+    // Transparent huge pages must be asked for before the pages are faulted in
+    if (flags & MEM_MAP_HUGEPAGE) {
+        populate = 0;
+    }
+
+    // Map a huge page more than needed and trim both ends to an aligned range
+    char* raw = (char*)mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | populate, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char* mem = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (mem > raw) {
+        munmap(raw, mem - raw);
+    }
+    munmap(mem + len, raw + HUGE_PAGE_SIZE - mem);
+
+    if (flags & MEM_MAP_HUGEPAGE) {
+        madvise(mem, len, MADV_HUGEPAGE);
+        if (flags & MEM_MAP_POPULATE) {
+            pool_prefault(mem, len);
+        }
+    }
+
+    *mapped_size = len;
+    return mem;
+}
+
+// Sets up a fresh backend heap over `size` bytes at `base` with the pool's
+// placement policy. Returns NULL on failure.
+static void* pool_create_heap(mem_pool_t* pool, void* base, size_t size) {
+    void* heap = pool->backend->create(base, size);
+    if (heap && pool->backend->set_placement) {
+        pool->backend->set_placement(heap, pool->placement);
+    }
+    return heap;
+}
+
+// Maps and publishes a new chunk big enough for a request of `size` bytes at
+// alignment `align`. Returns NULL once the growth cap is reached. If another
+// thread added a chunk since the caller looked (`seen_chunks`), that chunk is
+// returned instead so the caller tries it first.
+static Arena* pool_grow(mem_pool_t* pool, size_t size, size_t align, size_t seen_chunks) {
+    pthread_mutex_lock(&pool->grow_lock);
+
+    size_t chunk_count = pool->chunk_count;
+    if (chunk_count != seen_chunks) {
+        pthread_mutex_unlock(&pool->grow_lock);
+        return &pool->chunks[chunk_count - 1];
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t needed = (size + align + CHUNK_SLACK + page - 1) & ~(page - 1);
+    size_t chunk_size = pool->next_chunk_size > needed ? pool->next_chunk_size : needed;
+    if (pool->grown_size + chunk_size > pool->max_size) {
+        chunk_size = pool->max_size - pool->grown_size;
+    }
+    if (chunk_count == MAX_CHUNKS || chunk_size < needed) {
+        pthread_mutex_unlock(&pool->grow_lock);
+        return NULL;
+    }
+
+    Arena* chunk = &pool->chunks[chunk_count];
+    size_t mapped_size = chunk_size;
+    if (pool->map_flags) {
+        chunk->base = pool_map(chunk_size, pool->map_flags, &mapped_size);
+    } else {
+        chunk->base = (char*)mmap(NULL, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (chunk->base == MAP_FAILED) {
+            chunk->base = NULL;
+        }
+    }
+    chunk->heap = chunk->base ? pool_create_heap(pool, chunk->base, mapped_size) : NULL;
+    if (!chunk->heap) {
+        if (chunk->base) {
+            munmap(chunk->base, mapped_size);
+        }
+        pthread_mutex_unlock(&pool->grow_lock);
+        return NULL;
+    }
+    chunk->size = mapped_size;
+    pthread_mutex_init(&chunk->lock, NULL);
+    chunk->mutex = &chunk->lock;
+
+    pool->grown_size += chunk_size;
+    pool->next_chunk_size = chunk_size * 2;
+    __atomic_store_n(&pool->chunk_count, chunk_count + 1, __ATOMIC_RELEASE);
+
+    #ifdef DEBUG
+    printf("Grew memory pool by a chunk of %zu bytes at %p\n", mapped_size, chunk->base);
+    #endif
+
+    pthread_mutex_unlock(&pool->grow_lock);
+    return chunk;
+}
+
+// Sets up `pool` as described by `config`. Returns 0 on success; on failure
+// an error has been printed and nothing is left allocated. A file-backed
+// pool passes the mapped `file` and uses the memory after its header; with
+// `attach` the heap already in there is taken over instead of created.
+static int pool_setup(mem_pool_t* pool, const mem_config_t* config, PoolFileHeader* file, int attach) {
+    memset(pool, 0, sizeof(*pool));
+    pool->file_fd = -1;
+    if (file) {
+        pool->file = file;
+        pool->memory = (char*)file + FILE_HEADER_SIZE;
+        pool->mapped_size = FILE_HEADER_SIZE + config->size;
+    } else if (config->map_flags) {
+        pool->memory = pool_map(config->size, config->map_flags, &pool->mapped_size);
+        if (!pool->memory) {
+            perror("Memory pool mapping failed");
+            return -1;
+        }
+    } else if (posix_memalign((void**)&pool->memory, POOL_ALIGN, config->size ? config->size : 1) != 0) {
+        perror("Memory pool allocation failed");
+        return -1;
+    }
+
+    pool->size = config->size;
+    pool->backend = backend_for(config->backend);
+    pool->id = __atomic_add_fetch(&next_pool_id, 1, __ATOMIC_RELAXED);
+
+    pool->arena_count = config->arenas ? config->arenas : 1;
+    if (pool->arena_count > MAX_ARENAS) {
+        pool->arena_count = MAX_ARENAS;
+    }
+    pool->arena_policy = config->arena_policy;
+    pool->placement = config->placement;
+    // Keep arena boundaries cache-line aligned so aligned requests can be met in every arena
+    pool->arena_span = pool->arena_count == 1 ? config->size : (config->size / pool->arena_count) & ~(size_t)(ARENA_ALIGN - 1);
+    // 0 asks for the default; 1 for none, packing list blocks back to back
+    if (config->alignment == 0) {
+        pool->alignment = DEFAULT_ALIGNMENT;
+    } else {
+        pool->alignment = config->alignment > 1 ? (size_t)1 << size_class_fit(config->alignment) : 0;
+    }
+    if (config->tcache_count && pool->alignment < TCACHE_GRANULE) {
+        // A CacheHeader sits in front of every payload; the list backend
+        // would otherwise place it at any address
+        pool->alignment = TCACHE_GRANULE;
+    }
+
+    pool->purge_threshold = config->purge_threshold;
+    pool->purge_decay_ms = config->purge_decay_ms;
+    pool->purge_advice = MADV_DONTNEED;
+    #ifdef MADV_FREE
+    if (config->purge_mode == MEM_PURGE_FREE) {
+        pool->purge_advice = MADV_FREE;
+    }
+    #endif
+
+    pool->max_size = config->max_size > config->size ? config->max_size : 0;
+    pool->grown_size = config->size;
+    pool->next_chunk_size = config->size;
+    pool->map_flags = config->map_flags;
+    pthread_mutex_init(&pool->grow_lock, NULL);
+
+    for (size_t i = 0; i < pool->arena_count; i++) {
+        Arena* arena = &pool->arenas[i];
+        pthread_mutex_init(&arena->lock, NULL);
+        arena->mutex = &arena->lock;
+        arena->base = pool->memory + i * pool->arena_span;
+        arena->size = i + 1 < pool->arena_count ? pool->arena_span : config->size - i * pool->arena_span;
+        if (attach) {
+            arena->heap = pool->backend->attach(arena->base, arena->size, !file->clean);
+        } else {
+            arena->heap = pool->arena_span ? pool_create_heap(pool, arena->base, arena->size) : NULL;
+        }
+        if (!arena->heap) {
+            fprintf(stderr, "Failed to set up the %s backend for an arena of %zu bytes\n", pool->backend->name, arena->size);
+            pool_destroy_arenas(pool, i + 1);
+            pool_release_memory(pool);
+            return -1;
+        }
+    }
+
+    pool->tcache_count = config->tcache_count;
+    pool->tcache_batch = config->tcache_batch ? config->tcache_batch : (pool->tcache_count + 1) / 2;
+    if (pool->tcache_batch > pool->tcache_count) {
+        pool->tcache_batch = pool->tcache_count;
+    }
+    pool->tcache_max_size = config->tcache_max_size ? config->tcache_max_size : TCACHE_DEFAULT_MAX_SIZE;
+    if (pool->tcache_max_size > TCACHE_MAX_SIZE) {
+        pool->tcache_max_size = TCACHE_MAX_SIZE;
+    }
+    pool->tcache_header_size = pool->alignment > sizeof(CacheHeader) ? pool->alignment : sizeof(CacheHeader);
+    if (pool->tcache_count) {
+        pthread_mutex_init(&pool->tcache_lock, NULL);
+        if (pthread_key_create(&pool->tcache_key, tcache_thread_exit) != 0) {
+            // Run without caches rather than fail
+            pthread_mutex_destroy(&pool->tcache_lock);
+            pool->tcache_count = 0;
+        }
+    }
+
+    if (config->latency_clock != MEM_CLOCK_NONE) {
+        pool->latency_clock = config->latency_clock;
+        #ifdef HAVE_TSC
+        if (pool->latency_clock == MEM_CLOCK_TSC) {
+            pthread_once(&tsc_once, tsc_calibrate);
+        }
+        #else
+        pool->latency_clock = MEM_CLOCK_MONOTONIC;
+        #endif
+        // Run without histograms rather than fail
+        pool->latency = (LatencyShard*)calloc(STAT_SHARDS, sizeof(LatencyShard));
+    }
+
+    #ifdef DEBUG
+    printf("Initialized %s memory pool of size %zu at %p with %zu arena(s)\n", pool->backend->name, config->size, pool->memory, pool->arena_count);
+    #endif
+
+    return 0;
+}
+
+// Releases everything pool_setup acquired. Cached blocks need no flushing:
+// they go away with the pool.
+static void pool_teardown(mem_pool_t* pool) {
+    #ifdef MEM_LOCK_STATS
+    mem_lock_stats_t lock_stats[MEM_LOCK_OPS];
+    mem_pool_lock_stats(pool, lock_stats);
+    if (lock_stats[MEM_LOCK_ALLOC].acquires || lock_stats[MEM_LOCK_FREE].acquires) {
+        fprintf(stderr, "Lock statistics of %s memory pool %lu:\n", pool->backend->name, pool->id);
+        mem_pool_lock_stats_print(pool, stderr);
+    }
+    #endif
+
+    if (pool->tcache_count) {
+        pthread_key_delete(pool->tcache_key);
+        pthread_mutex_lock(&pool->tcache_lock);
+        while (pool->tcaches) {
+            tcache_delete(pool->tcaches);
+        }
+        pthread_mutex_unlock(&pool->tcache_lock);
+        pthread_mutex_destroy(&pool->tcache_lock);
+    }
+
+    pool_destroy_arenas(pool, pool->arena_count);
+    pool_destroy_chunks(pool);
+    if (pool->file && !pool->file->shared) {
+        pool->file->clean = 1;
+        msync(pool->file, pool->mapped_size, MS_SYNC);
+    }
+    pool_release_memory(pool);
+    if (pool->file_fd >= 0) {
+        close(pool->file_fd); // Lets the next process open the file
+    }
+    free(pool->latency);
+    memset(pool, 0, sizeof(*pool));
+}
+
+mem_pool_t* mem_pool_create(const mem_config_t* config) {
+    mem_pool_t* pool = (mem_pool_t*)malloc(sizeof(mem_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    if (pool_setup(pool, config, NULL, 0) != 0) {
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// Empties a pool file whose setup failed, so the next open creates it afresh
+static void file_discard(int fd, const char* path) {
+    if (ftruncate(fd, 0) != 0) {
+        fprintf(stderr, "%s could not be emptied: %s\n", path, strerror(errno));
+    }
+}
+
+// Sets up `pool` in the file at `path`, creating the file if it is missing or
+// empty. The file stays locked until the pool is destroyed, so a second
+// process cannot open it meanwhile. Returns a mem_file_status_t, or -1 after
+// printing an error.
+static int pool_setup_file(mem_pool_t* pool, const char* path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) {
+            fprintf(stderr, "%s is already in use by another memory pool\n", path);
+        } else {
+            perror(path);
+        }
+        close(fd);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    PoolFileHeader header;
+    int attach = st.st_size > 0;
+    if (attach) {
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != FILE_MAGIC ||
+            header.version != FILE_VERSION || header.shared || (uint64_t)st.st_size < FILE_HEADER_SIZE + header.size) {
+            fprintf(stderr, "%s does not hold a memory pool file\n", path);
+            close(fd);
+            return -1;
+        }
+        size = header.size;
+    } else if (ftruncate(fd, FILE_HEADER_SIZE + size) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    // Try the previous address first, so pointers stored in the pool stay valid
+    void* hint = attach ? (void*)(uintptr_t)header.base : NULL;
+    int fixed = 0;
+    #ifdef MAP_FIXED_NOREPLACE
+    fixed = hint ? MAP_FIXED_NOREPLACE : 0;
+    #endif
+    void* mem = mmap(hint, FILE_HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED | fixed, fd, 0);
+    if (mem == MAP_FAILED && fixed) {
+        mem = mmap(NULL, FILE_HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mem == MAP_FAILED) {
+        perror("Memory pool file mapping failed");
+        if (!attach) {
+            file_discard(fd, path);
+        }
+        close(fd);
+        return -1;
+    }
+
+    PoolFileHeader* file = (PoolFileHeader*)mem;
+    mem_config_t config = {.size = size, .backend = MEM_BACKEND_TAGS};
+    if (pool_setup(pool, &config, file, attach) != 0) {
+        if (attach) {
+            fprintf(stderr, "%s holds a damaged memory pool\n", path);
+        } else {
+            file_discard(fd, path);
+        }
+        close(fd);
+        return -1;
+    }
+    pool->file_fd = fd;
+
+    int status = MEM_FILE_CREATED;
+    if (attach) {
+        status = file->clean ? MEM_FILE_ATTACHED : MEM_FILE_RECOVERED;
+        if (file->base != (uintptr_t)mem) {
+            status |= MEM_FILE_MOVED;
+        }
+    } else {
+        file->magic = FILE_MAGIC;
+        file->version = FILE_VERSION;
+        file->size = size;
+    }
+    // Until the clean flag is set again, a later process rebuilds the heap
+    file->base = (uintptr_t)mem;
+    file->clean = 0;
+    msync(file, FILE_HEADER_SIZE, MS_SYNC);
+    return status;
+}
+
+// Waits for the process that created a shared pool to finish setting it up.
+// Returns the mapped size, or 0 if it does not show up within a second.
+static size_t shared_wait_ready(int fd) {
+    for (int i = 0; i < 1000; i++) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= FILE_HEADER_SIZE) {
+            uint64_t magic;
+            if (pread(fd, &magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) && magic == FILE_MAGIC) {
+                return (size_t)st.st_size;
+            }
+        }
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+    return 0;
+}
+
+// Sets up `pool` in the POSIX shared memory object `name`, creating it if it
+// does not exist, or in anonymous shared memory if `name` is NULL. Returns a
+// mem_file_status_t, or -1 after printing an error.
+static int pool_setup_shared(mem_pool_t* pool, const char* name, size_t size) {
+    int fd = -1;
+    int attach = 0;
+    size_t len = FILE_HEADER_SIZE + size;
+    if (name) {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) {
+            fd = shm_open(name, O_RDWR, 0);
+            attach = 1;
+        }
+        if (fd < 0) {
+            perror(name);
+            return -1;
+        }
+        if (attach) {
+            len = shared_wait_ready(fd);
+        } else if (ftruncate(fd, len) != 0) {
+            len = 0;
+        }
+        if (!len) {
+            fprintf(stderr, "%s does not hold a shared memory pool\n", name);
+            if (!attach) {
+                shm_unlink(name);
+            }
+            close(fd);
+            return -1;
+        }
+    }
+
+    void* mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | (name ? 0 : MAP_ANONYMOUS), fd, 0);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (mem == MAP_FAILED) {
+        perror("Shared memory pool mapping failed");
+        if (name && !attach) {
+            shm_unlink(name);
+        }
+        return -1;
+    }
+
+    PoolFileHeader* file = (PoolFileHeader*)mem;
+    if (attach && (file->version != FILE_VERSION || !file->shared || file->size != len - FILE_HEADER_SIZE)) {
+        fprintf(stderr, "%s does not hold a shared memory pool\n", name);
+        munmap(mem, len);
+        return -1;
+    }
+    if (!attach) {
+        file->version = FILE_VERSION;
+        file->size = size;
+        file->shared = 1;
+        file->clean = 1; // Crashes are caught by the robust lock instead
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&file->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    mem_config_t config = {.size = file->size, .backend = MEM_BACKEND_TAGS};
+    if (pool_setup(pool, &config, file, attach) != 0) {
+        if (name && !attach) {
+            shm_unlink(name);
+        }
+        return -1;
+    }
+    pool->arenas[0].mutex = &file->lock;
+    if (!attach) {
+        // Publish the pool to processes waiting in shared_wait_ready
+        __atomic_store_n(&file->magic, FILE_MAGIC, __ATOMIC_RELEASE);
+    }
+    return attach ? MEM_FILE_ATTACHED : MEM_FILE_CREATED;
+}
+
+mem_pool_t* mem_pool_create_shared(const char* name, size_t size, int* status) {
+    mem_pool_t* pool = (mem_pool_t*)malloc(sizeof(mem_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    int result = pool_setup_shared(pool, name, size);
+    if (status) {
+        *status = result;
+    }
+    if (result < 0) {
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+mem_pool_t* mem_pool_create_file(const char* path, size_t size, int* status) {
+    mem_pool_t* pool = (mem_pool_t*)malloc(sizeof(mem_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    int result = pool_setup_file(pool, path, size);
+    if (status) {
+        *status = result;
+    }
+    if (result < 0) {
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// Looks up a root slot of a file-backed pool; called with its arena locked
+static int pool_root_slot(mem_pool_t* pool, const char* name) {
+    for (int i = 0; i < FILE_ROOTS; i++) {
+        if (pool->file->roots[i].offset && strncmp(pool->file->roots[i].name, name, FILE_ROOT_NAME) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int mem_pool_set_root(mem_pool_t* pool, const char* name, void* ptr) {
+    if (!pool || !pool->file || strlen(name) >= FILE_ROOT_NAME || (ptr && !arena_of(pool, ptr))) {
+        return -1;
+    }
+
+    // The roots are guarded by the lock of the only arena, shared between processes if the pool is
+    arena_lock(&pool->arenas[0], MEM_LOCK_OTHER);
+    int slot = pool_root_slot(pool, name);
+    for (int i = 0; slot < 0 && ptr && i < FILE_ROOTS; i++) {
+        if (!pool->file->roots[i].offset) {
+            slot = i;
+            strncpy(pool->file->roots[i].name, name, FILE_ROOT_NAME);
+        }
+    }
+    if (slot >= 0) {
+        pool->file->roots[slot].offset = mem_pool_offset_of(pool, ptr);
+    }
+    arena_unlock(&pool->arenas[0]);
+    return slot >= 0 || !ptr ? 0 : -1;
+}
+
+void* mem_pool_get_root(mem_pool_t* pool, const char* name) {
+    if (!pool || !pool->file) {
+        return NULL;
+    }
+    arena_lock(&pool->arenas[0], MEM_LOCK_OTHER);
+    int slot = pool_root_slot(pool, name);
+    void* ptr = slot >= 0 ? mem_pool_ptr_at(pool, pool->file->roots[slot].offset) : NULL;
+    arena_unlock(&pool->arenas[0]);
+    return ptr;
+}
+
+size_t mem_pool_offset_of(mem_pool_t* pool, const void* ptr) {
+    if (!pool || !ptr) {
+        return 0;
+    }
+    return (size_t)((const char*)ptr - pool->memory);
+}
+
+void* mem_pool_ptr_at(mem_pool_t* pool, size_t offset) {
+    if (!pool || !offset) {
+        return NULL;
+    }
+    return pool->memory + offset;
+}
+
+// Allocates and frees without counting, for the API functions below
+static void* pool_alloc(mem_pool_t* pool, size_t size) {
+    return pool->tcache_count ? tcache_alloc(pool, size) : arena_alloc(pool, size, pool->alignment);
+}
+
+static int pool_free(mem_pool_t* pool, void* ptr, size_t* size) {
+    return pool->tcache_count ? tcache_free(pool, ptr, size) : arena_free(pool, ptr, size);
+}
+
+void* mem_pool_alloc(mem_pool_t* pool, size_t size) {
+    if (!pool) {
+        return NULL;
+    }
+
+    uint64_t start = latency_start(pool);
+    void* ptr = pool_alloc(pool, size);
+    latency_record(pool, MEM_OP_ALLOC, size, start);
+    if (ptr) {
+        STAT_ADD(pool, allocs, 1);
+    } else {
+        STAT_ADD(pool, failed_allocs, 1);
+    }
+
+    #ifdef DEBUG
+    if (ptr) {
+        printf("Allocated %zu bytes at %p\n", size, ptr);
+    }
+    #endif
+
+    return ptr;
+}
+
+void* mem_pool_alloc_aligned(mem_pool_t* pool, size_t size, size_t align) {
+    if (!pool || align == 0 || (align & (align - 1))) {
+        return NULL;
+    }
+    // Every block is aligned to the pool's default anyway
+    if (align <= pool->alignment) {
+        return mem_pool_alloc(pool, size);
+    }
+
+    uint64_t start = latency_start(pool);
+    void* ptr = pool->tcache_count ? tcache_alloc_aligned(pool, size, align) : arena_alloc(pool, size, align);
+    latency_record(pool, MEM_OP_ALLOC, size, start);
+    if (ptr) {
+        STAT_ADD(pool, allocs, 1);
+    } else {
+        STAT_ADD(pool, failed_allocs, 1);
+    }
+
+    #ifdef DEBUG
+    if (ptr) {
+        printf("Allocated %zu bytes aligned to %zu at %p\n", size, align, ptr);
+    }
+    #endif
+
+    return ptr;
+}
+
+// Carves the blocks out of one free block of the home arena if it has one
+// that holds them all, else places them one by one under the same lock, then
+// falls back to one block at a time from wherever there is room. Thread
+// caches are bypassed: the blocks get their CacheHeaders here and are freed
+// into the caches like any other.
+size_t mem_pool_alloc_batch(mem_pool_t* pool, size_t size, size_t count, void** ptrs) {
+    if (!pool) {
+        return 0;
+    }
+
+    // Blocks of a size the caches serve keep a size that names their class
+    size_t usable = size;
+    size_t offset = pool->tcache_count ? pool->tcache_header_size : 0;
+    if (pool->tcache_count && size <= pool->tcache_max_size) {
+        usable = size ? (size + TCACHE_GRANULE - 1) & ~(size_t)(TCACHE_GRANULE - 1) : TCACHE_GRANULE;
+    }
+
+    size_t done = 0;
+    if (usable <= SIZE_MAX - offset) {
+        size_t block_size = pool_round(pool, offset + usable);
+        Arena* arena = home_arena(pool);
+        arena_lock(arena, MEM_LOCK_ALLOC);
+        if (pool->backend->alloc_run && count > 1) {
+            done = pool->backend->alloc_run(arena->heap, block_size, count, pool->alignment, ptrs);
+        }
+        while (done < count && (ptrs[done] = backend_alloc(pool, arena, block_size, pool->alignment)) != NULL) {
+            done++;
+        }
+        arena_unlock(arena);
+        STAT_ADD(pool, allocs, done);
+
+        for (size_t i = 0; offset && i < done; i++) {
+            CacheHeader* header = tcache_header_in(pool, ptrs[i]);
+            header->size = usable;
+            header->tag = TCACHE_LIVE;
+            ptrs[i] = header + 1;
+        }
+    }
+    while (done < count && (ptrs[done] = mem_pool_alloc(pool, size)) != NULL) {
+        done++;
+    }
+
+    #ifdef DEBUG
+    printf("Allocated %zu of %zu blocks of %zu bytes\n", done, count, size);
+    #endif
+
+    return done;
+}
+
+// Reports a failed free the same way for mem_pool_free and mem_pool_free_batch
+static void free_warning(void* ptr, int status) {
+    if (status == MEM_ERR_NOT_FOUND) {
+        fprintf(stderr, "Warning: Pointer %p not found in the memory pool.\n", ptr);
+    } else if (status == MEM_ERR_NOT_ALLOCATED) {
+        fprintf(stderr, "Warning: Attempted to free an already freed block at %p.\n", ptr);
+    }
+}
+
+void mem_pool_free(mem_pool_t* pool, void* ptr) {
+    if (!ptr) {
+        fprintf(stderr, "Warning: Attempted to free a NULL pointer.\n");
+        return;
+    }
+
+    int status = MEM_ERR_NOT_FOUND;
+    if (pool) {
+        // The size class is read by the free itself, before the block is gone
+        size_t size = 0;
+        uint64_t start = latency_start(pool);
+        status = pool_free(pool, ptr, pool->latency ? &size : NULL);
+        latency_record(pool, MEM_OP_FREE, size, start);
+    }
+    free_warning(ptr, status);
+    if (status == MEM_OK) {
+        STAT_ADD(pool, frees, 1);
+    }
+
+    #ifdef DEBUG
+    if (status == MEM_OK) {
+        printf("Freed block at %p\n", ptr);
+    }
+    #endif
+}
+
+static int compare_descending(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(void* const*)a, y = (uintptr_t)*(void* const*)b;
+    return (x < y) - (x > y);
+}
+
+// Sorts pointers into descending address order. Small batches are insertion
+// sorted; larger ones are radix sorted, a byte at a time, on just the bits in
+// which the pointers differ, which is only a few passes for blocks from one pool.
+#define BATCH_INSERTION_SORT_MAX 32
+
+static void sort_descending(void** ptrs, size_t count) {
+    if (count <= BATCH_INSERTION_SORT_MAX) {
+        for (size_t i = 1; i < count; i++) {
+            void* ptr = ptrs[i];
+            size_t j = i;
+            for (; j > 0 && (uintptr_t)ptrs[j - 1] < (uintptr_t)ptr; j--) {
+                ptrs[j] = ptrs[j - 1];
+            }
+            ptrs[j] = ptr;
+        }
+        return;
+    }
+
+    void** scratch = (void**)malloc(count * sizeof(void*));
+    if (!scratch) {
+        qsort(ptrs, count, sizeof(void*), compare_descending);
+        return;
+    }
+
+    uintptr_t lowest = UINTPTR_MAX, highest = 0, bits = 0;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t addr = (uintptr_t)ptrs[i];
+        lowest = addr < lowest ? addr : lowest;
+        highest = addr > highest ? addr : highest;
+        bits |= addr;
+    }
+    int shift = bits ? __builtin_ctzll(bits) : 0; // Low bits every pointer has clear
+    uintptr_t span = (highest - lowest) >> shift;
+
+    void** src = ptrs;
+    void** dst = scratch;
+    for (int pass = 0; pass < (int)(8 * sizeof(uintptr_t)) && (span >> pass) != 0; pass += 8) {
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < count; i++) {
+            offsets[255 - ((((uintptr_t)src[i] - lowest) >> shift >> pass) & 255)]++;
+        }
+        size_t total = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t n = offsets[digit];
+            offsets[digit] = total;
+            total += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dst[offsets[255 - ((((uintptr_t)src[i] - lowest) >> shift >> pass) & 255)]++] = src[i];
+        }
+        void** tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != ptrs) {
+        memcpy(ptrs, src, count * sizeof(void*));
+    }
+    free(scratch);
+}
+
+// Frees from the highest address down, so that every block is merged with
+// the free run left by the block after it, and takes each arena lock once
+// per run of blocks that share it. With thread caches the blocks go straight
+// back to their arenas rather than into the caches.
+void mem_pool_free_batch(mem_pool_t* pool, void** ptrs, size_t count) {
+    if (!pool) {
+        for (size_t i = 0; i < count; i++) {
+            mem_pool_free(pool, ptrs[i]);
+        }
+        return;
+    }
+
+    sort_descending(ptrs, count);
+
+    Arena* locked = NULL;
+    size_t freed = 0;
+    for (size_t i = 0; i < count; i++) {
+        void* ptr = ptrs[i];
+        void* block = ptr;
+        int status = MEM_ERR_NOT_FOUND;
+        if (ptr && pool->tcache_count) {
+            block = tcache_unwrap(pool, ptr, &status);
+        }
+        Arena* arena = block ? arena_of(pool, block) : NULL;
+        if (!arena) {
+            if (!ptr) {
+                fprintf(stderr, "Warning: Attempted to free a NULL pointer.\n");
+            } else {
+                free_warning(ptr, status);
+            }
+            continue;
+        }
+        if (arena != locked) {
+            if (locked) {
+                arena_freed(pool, locked);
+                arena_unlock(locked);
+            }
+            arena_lock(arena, MEM_LOCK_FREE);
+            locked = arena;
+        }
+        status = pool->backend->free(arena->heap, block);
+        free_warning(ptr, status);
+        freed += status == MEM_OK;
+    }
+    if (locked) {
+        arena_freed(pool, locked);
+        arena_unlock(locked);
+    }
+    STAT_ADD(pool, frees, freed);
+
+    #ifdef DEBUG
+    printf("Freed a batch of %zu blocks\n", count);
+    #endif
+}
+
+// Resizes a block with a CacheHeader in place where possible. Returns MEM_OK
+// if `ptr` now holds `size` bytes, MEM_ERR_NO_ROOM with the current usable
+// size in *old_size if it has to move, or another MEM_ERR_* for a bad pointer.
+static int tcache_resize(mem_pool_t* pool, void* ptr, size_t size, size_t* old_size) {
+    CacheHeader* header = tcache_header_of(pool, ptr);
+    if (!header || (header->tag != TCACHE_LIVE && header->tag != TCACHE_ALIGNED)) {
+        return MEM_ERR_NOT_FOUND;
+    }
+
+    // Cacheable blocks keep a size that names their class
+    size_t usable = size;
+    size_t offset = pool->tcache_header_size;
+    if (header->tag == TCACHE_ALIGNED) {
+        offset = header->size;
+    } else if (size <= pool->tcache_max_size) {
+        usable = size ? (size + TCACHE_GRANULE - 1) & ~(size_t)(TCACHE_GRANULE - 1) : TCACHE_GRANULE;
+        if (usable == header->size) {
+            return MEM_OK;
+        }
+    }
+
+    char* block = (char*)ptr - offset;
+    Arena* arena = arena_of(pool, block);
+    arena_lock(arena, MEM_LOCK_RESIZE);
+    pool->backend->block_size(arena->heap, block, old_size);
+    int status = pool->backend->resize(arena->heap, block, pool_round(pool, offset + usable));
+    arena_unlock(arena);
+    *old_size -= offset;
+
+    if (status == MEM_OK) {
+        if (header->tag == TCACHE_LIVE) {
+            header->size = usable;
+        }
+        return MEM_OK;
+    }
+    if (header->tag == TCACHE_LIVE) {
+        *old_size = header->size;
+    }
+    // A block that could not shrink is still large enough
+    return *old_size >= size ? MEM_OK : MEM_ERR_NO_ROOM;
+}
+
+int mem_pool_resize_in_place(mem_pool_t* pool, void* ptr, size_t size) {
+    if (pool->tcache_count) {
+        size_t old_size;
+        return tcache_resize(pool, ptr, size, &old_size);
+    }
+
+    Arena* arena = arena_of(pool, ptr);
+    if (!arena) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    arena_lock(arena, MEM_LOCK_RESIZE);
+    int status = pool->backend->resize(arena->heap, ptr, pool_round(pool, size));
+    arena_unlock(arena);
+    return status;
+}
+
+// Resizes a block of `pool`, moving it if it has to
+static void* pool_resize(mem_pool_t* pool, void* ptr, size_t size) {
+    size_t old_size;
+    if (pool->tcache_count) {
+        int status = tcache_resize(pool, ptr, size, &old_size);
+        if (status == MEM_OK) {
+            STAT_ADD(pool, resizes, 1);
+            return ptr;
+        }
+        if (status != MEM_ERR_NO_ROOM) {
+            fprintf(stderr, "Warning: Pointer %p not found for resizing.\n", ptr);
+            return NULL;
+        }
+    } else {
+        Arena* arena = arena_of(pool, ptr);
+        if (!arena) {
+            fprintf(stderr, "Warning: Pointer %p not found for resizing.\n", ptr);
+            return NULL;
+        }
+
+        arena_lock(arena, MEM_LOCK_RESIZE);
+
+        // Grow into the following free block or give the tail back
+        int status = pool->backend->resize(arena->heap, ptr, pool_round(pool, size));
+        if (status == MEM_OK) {
+            arena_unlock(arena);
+            STAT_ADD(pool, resizes, 1);
+            return ptr;
+        }
+        if (status != MEM_ERR_NO_ROOM || pool->backend->block_size(arena->heap, ptr, &old_size) != MEM_OK) {
+            arena_unlock(arena);
+            fprintf(stderr, "Warning: Pointer %p not found for resizing.\n", ptr);
+            return NULL;
+        }
+        if (old_size >= size) {
+            arena_unlock(arena);
+            STAT_ADD(pool, resizes, 1);
+            return ptr;
+        }
+
+        // Prefer moving within the same arena while its lock is held
+        void* new_ptr = backend_alloc(pool, arena, size, pool->alignment);
+        if (new_ptr) {
+            memcpy(new_ptr, ptr, old_size);
+            pool->backend->free(arena->heap, ptr);
+            arena_freed(pool, arena);
+        }
+
+        arena_unlock(arena);
+        if (new_ptr) {
+            STAT_ADD(pool, resizes, 1);
+            return new_ptr;
+        }
+        if (pool->arena_count == 1 && !pool->max_size) {
+            STAT_ADD(pool, failed_allocs, 1);
+            return NULL;
+        }
+    }
+
+    void* new_ptr = pool_alloc(pool, size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+        pool_free(pool, ptr, NULL);
+        STAT_ADD(pool, resizes, 1);
+    } else {
+        STAT_ADD(pool, failed_allocs, 1);
+    }
+    return new_ptr;
+}
+
+void* mem_pool_resize(mem_pool_t* pool, void* ptr, size_t size) {
+    if (!ptr) {
+        return mem_pool_alloc(pool, size);
+    }
+    if (!pool) {
+        fprintf(stderr, "Warning: Pointer %p not found for resizing.\n", ptr);
+        return NULL;
+    }
+
+    uint64_t start = latency_start(pool);
+    void* new_ptr = pool_resize(pool, ptr, size);
+    latency_record(pool, MEM_OP_RESIZE, size, start);
+    return new_ptr;
+}
+
+void mem_pool_destroy(mem_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    pool_teardown(pool);
+    free(pool);
+
+    #ifdef DEBUG
+    printf("Destroyed memory pool\n");
+    #endif
+}
+
+size_t mem_pool_trim(mem_pool_t* pool) {
+    if (!pool) {
+        return 0;
+    }
+
+    // Blocks in the calling thread's cache are free as far as it is concerned
+    if (pool->tcache_count) {
+        ThreadCache* cache = tcache_local_id == pool->id ? tcache_local : (ThreadCache*)pthread_getspecific(pool->tcache_key);
+        if (cache) {
+            tcache_flush_all(cache);
+        }
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t purged = 0;
+    for (size_t i = 0; i < pool->arena_count; i++) {
+        Arena* arena = &pool->arenas[i];
+        arena_lock(arena, MEM_LOCK_OTHER);
+        purged += arena_purge(pool, arena, page);
+        arena_unlock(arena);
+    }
+    size_t chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < chunk_count; i++) {
+        Arena* chunk = &pool->chunks[i];
+        arena_lock(chunk, MEM_LOCK_OTHER);
+        purged += arena_purge(pool, chunk, page);
+        arena_unlock(chunk);
+    }
+
+    #ifdef DEBUG
+    printf("Trimmed %zu bytes from memory pool %lu\n", purged, pool->id);
+    #endif
+
+    return purged;
+}
+
+// Adds the occupancy of one arena or chunk to `stats`
+static void arena_stats(mem_pool_t* pool, Arena* arena, mem_stats_t* stats) {
+    mem_backend_stats heap_stats;
+    arena_lock(arena, MEM_LOCK_OTHER);
+    pool->backend->stats(arena->heap, &heap_stats);
+    arena_unlock(arena);
+
+    stats->bytes_in_use += heap_stats.used_bytes;
+    stats->bytes_free += heap_stats.free_bytes;
+    stats->peak_bytes_in_use += heap_stats.peak_used_bytes;
+    stats->blocks_in_use += heap_stats.used_blocks;
+    stats->free_blocks += heap_stats.free_blocks;
+    if (heap_stats.largest_free > stats->largest_free_block) {
+        stats->largest_free_block = heap_stats.largest_free;
+    }
+}
+
+void mem_pool_stats(mem_pool_t* pool, mem_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!pool) {
+        return;
+    }
+
+    stats->pool_size = pool->size;
+    for (size_t i = 0; i < pool->arena_count; i++) {
+        arena_stats(pool, &pool->arenas[i], stats);
+    }
+    size_t chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < chunk_count; i++) {
+        stats->pool_size += pool->chunks[i].size;
+        arena_stats(pool, &pool->chunks[i], stats);
+    }
+    if (stats->bytes_free) {
+        stats->fragmentation = 1.0 - (double)stats->largest_free_block / stats->bytes_free;
+    }
+
+    for (int i = 0; i < STAT_SHARDS; i++) {
+        stats->allocs += __atomic_load_n(&pool->stats[i].allocs, __ATOMIC_RELAXED);
+        stats->frees += __atomic_load_n(&pool->stats[i].frees, __ATOMIC_RELAXED);
+        stats->resizes += __atomic_load_n(&pool->stats[i].resizes, __ATOMIC_RELAXED);
+        stats->failed_allocs += __atomic_load_n(&pool->stats[i].failed_allocs, __ATOMIC_RELAXED);
+    }
+}
+
+// A copy of the block map of a pool, see pool_snapshot
+typedef struct BlockSnapshot {
+    mem_block_info_t* blocks;
+    size_t count;
+    size_t capacity;
+    size_t pool_size; // Bytes the arenas and chunks span
+    int failed;       // Set when the copy ran out of memory
+    // Arena being copied
+    int arena;
+    char* base;
+    size_t offset;
+} BlockSnapshot;
+
+static void snapshot_block(void* start, size_t size, int is_free, void* ctx) {
+    BlockSnapshot* snap = (BlockSnapshot*)ctx;
+    if (snap->count == snap->capacity) {
+        size_t capacity = snap->capacity ? 2 * snap->capacity : 256;
+        mem_block_info_t* blocks = (mem_block_info_t*)realloc(snap->blocks, capacity * sizeof(mem_block_info_t));
+        if (!blocks) {
+            snap->failed = 1;
+            return;
+        }
+        snap->blocks = blocks;
+        snap->capacity = capacity;
+    }
+
+    mem_block_info_t* info = &snap->blocks[snap->count++];
+    info->offset = snap->offset + (size_t)((char*)start - snap->base);
+    info->address = start;
+    info->size = size;
+    info->is_free = is_free;
+    info->arena = snap->arena;
+}
+
+// Copies the block map of every arena and chunk. Each arena's lock is held
+// only while its own blocks are copied, so every arena is consistent in
+// itself and the pool is never stopped as a whole. Chunks are numbered and
+// placed after the arenas, as if they followed the initial memory.
+static int pool_snapshot(mem_pool_t* pool, BlockSnapshot* snap) {
+    memset(snap, 0, sizeof(*snap));
+    snap->pool_size = pool->size;
+    size_t chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < pool->arena_count + chunk_count && !snap->failed; i++) {
+        Arena* arena = i < pool->arena_count ? &pool->arenas[i] : &pool->chunks[i - pool->arena_count];
+        snap->arena = (int)i;
+        snap->base = arena->base;
+        if (i < pool->arena_count) {
+            snap->offset = (size_t)(arena->base - pool->memory);
+        } else {
+            snap->offset = snap->pool_size;
+            snap->pool_size += arena->size;
+        }
+
+        arena_lock(arena, MEM_LOCK_OTHER);
+        pool->backend->walk(arena->heap, snapshot_block, snap);
+        arena_unlock(arena);
+    }
+
+    if (snap->failed) {
+        free(snap->blocks);
+        return -1;
+    }
+    return 0;
+}
+
+int mem_pool_walk(mem_pool_t* pool, mem_walk_fn fn, void* ctx) {
+    BlockSnapshot snap;
+    if (!pool || pool_snapshot(pool, &snap) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < snap.count; i++) {
+        fn(&snap.blocks[i], ctx);
+    }
+    free(snap.blocks);
+    return 0;
+}
+
+int mem_pool_dump(mem_pool_t* pool, const char* path) {
+    BlockSnapshot snap;
+    if (!pool || pool_snapshot(pool, &snap) != 0) {
+        return -1;
+    }
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        free(snap.blocks);
+        return -1;
+    }
+
+    fprintf(out, "# %s pool of %zu bytes\n", pool->backend->name, snap.pool_size);
+    fprintf(out, "arena,offset,size,state\n");
+    for (size_t i = 0; i < snap.count; i++) {
+        mem_block_info_t* block = &snap.blocks[i];
+        fprintf(out, "%d,%zu,%zu,%s\n", block->arena, block->offset, block->size, block->is_free ? "free" : "used");
+    }
+    free(snap.blocks);
+
+    int failed = ferror(out);
+    return fclose(out) != 0 || failed ? -1 : 0;
+}
+
+#ifdef MEM_LOCK_STATS
+// Adds the lock counters of one arena or chunk to `stats`
+static void arena_lock_stats(Arena* arena, mem_lock_stats_t stats[MEM_LOCK_OPS]) {
+    pthread_mutex_lock(arena->mutex);
+    for (int op = 0; op < MEM_LOCK_OPS; op++) {
+        mem_lock_stats_t* from = &arena->lock_stats[op];
+        stats[op].acquires += from->acquires;
+        stats[op].contended += from->contended;
+        stats[op].wait_ns += from->wait_ns;
+        stats[op].hold_ns += from->hold_ns;
+        if (from->max_wait_ns > stats[op].max_wait_ns) {
+            stats[op].max_wait_ns = from->max_wait_ns;
+        }
+        if (from->max_hold_ns > stats[op].max_hold_ns) {
+            stats[op].max_hold_ns = from->max_hold_ns;
+        }
+    }
+    pthread_mutex_unlock(arena->mutex);
+}
+#endif
+
+int mem_pool_lock_stats(mem_pool_t* pool, mem_lock_stats_t stats[MEM_LOCK_OPS]) {
+    memset(stats, 0, MEM_LOCK_OPS * sizeof(mem_lock_stats_t));
+    #ifdef MEM_LOCK_STATS
+    if (!pool) {
+        return 0;
+    }
+    for (size_t i = 0; i < pool->arena_count; i++) {
+        arena_lock_stats(&pool->arenas[i], stats);
+    }
+    size_t chunk_count = __atomic_load_n(&pool->chunk_count, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < chunk_count; i++) {
+        arena_lock_stats(&pool->chunks[i], stats);
+    }
+    return 0;
+    #else
+    (void)pool;
+    return -1;
+    #endif
+}
+
+void mem_pool_lock_stats_print(mem_pool_t* pool, FILE* out) {
+    static const char* names[MEM_LOCK_OPS] = {"alloc", "free", "resize", "other"};
+    mem_lock_stats_t stats[MEM_LOCK_OPS];
+    if (mem_pool_lock_stats(pool, stats) != 0) {
+        fprintf(out, "Lock statistics are not compiled in (build with -DMEM_LOCK_STATS).\n");
+        return;
+    }
+
+    fprintf(out, "%-8s %12s %12s %14s %12s %14s %12s\n", "op", "acquires", "contended", "avg wait ns", "max wait ns", "avg hold ns", "max hold ns");
+    for (int op = 0; op < MEM_LOCK_OPS; op++) {
+        uint64_t acquires = stats[op].acquires ? stats[op].acquires : 1;
+        fprintf(out, "%-8s %12llu %12llu %14.1f %12llu %14.1f %12llu\n", names[op],
+                (unsigned long long)stats[op].acquires, (unsigned long long)stats[op].contended,
+                (double)stats[op].wait_ns / acquires, (unsigned long long)stats[op].max_wait_ns,
+                (double)stats[op].hold_ns / acquires, (unsigned long long)stats[op].max_hold_ns);
+    }
+}
+
+int mem_pool_latency_snapshot(mem_pool_t* pool, mem_histogram_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+    if (!pool || !pool->latency) {
+        return -1;
+    }
+
+    uint64_t* to = &hist->counts[0][0][0];
+    for (int i = 0; i < STAT_SHARDS; i++) {
+        uint64_t* from = &pool->latency[i].counts[0][0][0];
+        for (size_t j = 0; j < sizeof(hist->counts) / sizeof(uint64_t); j++) {
+            to[j] += __atomic_load_n(&from[j], __ATOMIC_RELAXED);
+        }
+    }
+    return 0;
+}
+
+void mem_pool_latency_reset(mem_pool_t* pool) {
+    if (!pool || !pool->latency) {
+        return;
+    }
+    for (int i = 0; i < STAT_SHARDS; i++) {
+        uint64_t* counts = &pool->latency[i].counts[0][0][0];
+        for (size_t j = 0; j < sizeof(pool->latency[i].counts) / sizeof(uint64_t); j++) {
+            __atomic_store_n(&counts[j], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+mem_pool_t* mem_default_pool() {
+    return default_pool;
+}
+
+// Initializes the default memory pool as described by `config`
+void mem_init_ex(const mem_config_t* config) {
+    if (pool_setup(&default_pool_storage, config, NULL, 0) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    default_pool = &default_pool_storage;
+}
+
+// Initializes the memory pool in a file, reattaching to the pool it holds
+int mem_init_file(const char* path, size_t size) {
+    int status = pool_setup_file(&default_pool_storage, path, size);
+    if (status >= 0) {
+        default_pool = &default_pool_storage;
+    }
+    return status;
+}
+
+// Initializes the memory pool in shared memory, attaching to it if it exists
+int mem_init_shared(const char* name, size_t size) {
+    int status = pool_setup_shared(&default_pool_storage, name, size);
+    if (status >= 0) {
+        default_pool = &default_pool_storage;
+    }
+    return status;
+}
+
+// Names a block of the default pool so a later process can find it
+int mem_set_root(const char* name, void* ptr) {
+    return mem_pool_set_root(default_pool, name, ptr);
+}
+
+// Finds a block named by mem_set_root
+void* mem_get_root(const char* name) {
+    return mem_pool_get_root(default_pool, name);
+}
+
+// Turns a pointer into the default pool into an offset that survives a restart
+size_t mem_offset_of(const void* ptr) {
+    return mem_pool_offset_of(default_pool, ptr);
+}
+
+// Turns an offset from mem_offset_of back into a pointer
+void* mem_ptr_at(size_t offset) {
+    return mem_pool_ptr_at(default_pool, offset);
+}
+
+// Initializes the memory pool with the specified size
+void mem_init(size_t size) {
+    mem_init_ex(&(mem_config_t){.size = size, .backend = MEM_BACKEND_LIST});
+}
+
+void* mem_alloc(size_t size) {
+    return mem_pool_alloc(default_pool, size);
+}
+
+// Frees a previously allocated block of memory
+void mem_free(void* ptr) {
+    mem_pool_free(default_pool, ptr);
+}
+
+// Allocates `count` blocks of `size` bytes in one go
+size_t mem_alloc_batch(size_t size, size_t count, void** ptrs) {
+    return mem_pool_alloc_batch(default_pool, size, count, ptrs);
+}
+
+// Frees `count` blocks in one go
+void mem_free_batch(void** ptrs, size_t count) {
+    mem_pool_free_batch(default_pool, ptrs, count);
+}
+
+// Allocates a block whose address is a multiple of `align`
+void* mem_alloc_aligned(size_t size, size_t align) {
+    return mem_pool_alloc_aligned(default_pool, size, align);
+}
+
+// Resizes a previously allocated block of memory
+void* mem_resize(void* ptr, size_t size) {
+    return mem_pool_resize(default_pool, ptr, size);
+}
+
+// Fills in statistics of the default pool
+void mem_stats(mem_stats_t* stats) {
+    mem_pool_stats(default_pool, stats);
+}
+
+// Reports every block of the default pool
+int mem_walk(mem_walk_fn fn, void* ctx) {
+    return mem_pool_walk(default_pool, fn, ctx);
+}
+
+// Writes the block map of the default pool to a file
+int mem_dump(const char* path) {
+    return mem_pool_dump(default_pool, path);
+}
+
+// Fills in the lock statistics of the default pool
+int mem_lock_stats(mem_lock_stats_t stats[MEM_LOCK_OPS]) {
+    return mem_pool_lock_stats(default_pool, stats);
+}
+
+// Prints the lock statistics of the default pool
+void mem_lock_stats_print(FILE* out) {
+    mem_pool_lock_stats_print(default_pool, out);
+}
+
+// Adds up the latency histograms of the default pool
+int mem_latency_snapshot(mem_histogram_t* hist) {
+    return mem_pool_latency_snapshot(default_pool, hist);
+}
+
+// Clears the latency histograms of the default pool
+void mem_latency_reset() {
+    mem_pool_latency_reset(default_pool);
+}
+
+// Hands the pages of free memory back to the OS
+size_t mem_trim() {
+    return mem_pool_trim(default_pool);
+}
+
+// Deinitializes the memory pool and frees all associated resources
+void mem_deinit() {
+    if (!default_pool) {
+        return;
+    }
+    pool_teardown(default_pool);
+    default_pool = NULL;
 
     #ifdef DEBUG
     printf("Deinitialized memory pool\n");
@@ -2,6 +2,8 @@
 #define MEMORY_MANAGER_H
 
 #include <stddef.h> // For size_t
+#include <stdint.h> // For uint64_t
+#include <stdio.h>  // For FILE
 
 // Helps C++ compilers to handle C header files
 #ifdef __cplusplus
@@ -9,6 +11,134 @@ extern "C"
 {
 #endif
 
+    /**
+     * Allocation backends that can manage the memory pool.
+     */
+    typedef enum
+    {
+        MEM_BACKEND_LIST = 0, // Block metadata kept outside the pool; the whole pool is usable (default)
+        MEM_BACKEND_TAGS,     // Boundary-tag headers/footers stored inside the pool; no libc calls after init
+        MEM_BACKEND_BUDDY,    // Binary buddy system: power-of-two blocks, O(log n) alloc/free
+        MEM_BACKEND_TLSF      // Two-level segregated fit: O(1) worst-case alloc/free for latency-bound callers
+    } mem_backend_t;
+
+    /**
+     * How threads are assigned to arenas when the pool is split into several.
+     */
+    typedef enum
+    {
+        MEM_ARENA_ROUND_ROBIN = 0, // Each thread gets the next arena on its first allocation (default)
+        MEM_ARENA_PER_CPU          // Threads use the arena of the CPU they are currently running on
+    } mem_arena_policy_t;
+
+    /**
+     * Flags for mem_config_t.map_flags, selecting how the pool memory is
+     * obtained. Any flag maps the pool with mmap, on a 2 MiB boundary and
+     * rounded up to a multiple of 2 MiB; without flags it comes from the heap.
+     */
+    typedef enum
+    {
+        MEM_MAP_ANONYMOUS = 1 << 0, // mmap the pool instead of taking it from the heap
+        MEM_MAP_POPULATE = 1 << 1,  // Fault in every page during init so that first touches do not fault
+        MEM_MAP_HUGEPAGE = 1 << 2,  // Ask for transparent huge pages (MADV_HUGEPAGE) to cut TLB misses
+        MEM_MAP_HUGETLB = 1 << 3    // Use reserved huge pages (MAP_HUGETLB), falling back to MEM_MAP_HUGEPAGE
+    } mem_map_flags_t;
+
+    /**
+     * How free memory is handed back to the OS, see mem_config_t.purge_threshold.
+     */
+    typedef enum
+    {
+        MEM_PURGE_DONTNEED = 0, // MADV_DONTNEED: pages are dropped at once and read back as zeros (default)
+        MEM_PURGE_FREE          // MADV_FREE: pages are dropped when the OS runs short of memory; cheaper to reuse
+    } mem_purge_mode_t;
+
+    /**
+     * Clock timing the operations recorded in the latency histograms, see
+     * mem_config_t.latency_clock.
+     */
+    typedef enum
+    {
+        MEM_CLOCK_NONE = 0,  // No latency histograms (default)
+        MEM_CLOCK_MONOTONIC, // clock_gettime(CLOCK_MONOTONIC): portable, some tens of ns per reading
+        MEM_CLOCK_TSC        // The time stamp counter, calibrated at init; MEM_CLOCK_MONOTONIC where there is none
+    } mem_latency_clock_t;
+
+    /**
+     * Which free block MEM_BACKEND_LIST hands out when several can hold a
+     * request, see mem_config_t.placement.
+     */
+    typedef enum
+    {
+        MEM_PLACE_CLASS_FIT = 0, // First block of the lowest size class certain to fit, in O(1) (default)
+        MEM_PLACE_FIRST_FIT,     // Lowest-addressed free block that fits, found by walking the blocks
+        MEM_PLACE_NEXT_FIT,      // First fit in address order, resuming where the previous search left off
+        MEM_PLACE_BEST_FIT       // Smallest free block that fits, found in O(log n); leaves the large ones whole
+    } mem_placement_t;
+
+    /**
+     * Configuration for mem_init_ex. Zero-initialized fields select the defaults.
+     */
+    typedef struct
+    {
+        size_t size;           // Size of the memory pool in bytes, including any in-pool metadata
+        mem_backend_t backend; // Allocation backend managing the pool
+        mem_placement_t placement; // Placement policy of MEM_BACKEND_LIST; the other backends ignore it
+
+        // Per-thread caches of recently freed blocks, serving most alloc/free
+        // pairs without taking the pool lock. Every block then carries a
+        // 16-byte header and is aligned to at least 16 bytes, and small
+        // requests are rounded up to 16 bytes.
+        size_t tcache_count;    // Blocks cached per size class in each thread; 0 disables the caches (default)
+        size_t tcache_batch;    // Blocks moved per refill or flush; defaults to half of tcache_count
+        size_t tcache_max_size; // Largest request served from the caches; defaults to 256, at most 1024
+
+        // Splits the pool into independent arenas, each with its own lock and
+        // free structures. A thread allocates from its own arena first and
+        // falls back to the others; a block is always freed into the arena it
+        // came from. A single request can never be larger than one arena.
+        size_t arenas;                   // Number of arenas, at most 64; 0 or 1 keeps a single arena (default)
+        mem_arena_policy_t arena_policy; // How threads are mapped to arenas
+
+        // Alignment of every block mem_alloc and mem_resize return, rounded up
+        // to a power of two; requests are rounded up to a multiple of it.
+        // 0 gives alignof(max_align_t), 16 on x86-64 (default). 1 turns
+        // alignment off: the list backend then packs blocks back to back at
+        // any address (unless thread caches are on), the others still align
+        // to 16. Only then can the whole pool be filled exactly.
+        size_t alignment;
+
+        unsigned int map_flags; // MEM_MAP_* flags; 0 takes the pool from the heap (default)
+
+        // Growth cap. When larger than size, a pool that runs out of room maps
+        // additional chunks, each at least twice the size of the previous
+        // one, until the pool spans max_size bytes in total. Blocks never
+        // move when the pool grows. 0 keeps the pool at its initial size.
+        size_t max_size;
+
+        // Returning free memory to the OS. The pages of free runs of at least
+        // purge_threshold bytes are handed back purge_decay_ms after a free
+        // into their arena (0 purges on every free, only sensible for a
+        // few large blocks). The pages are mapped in again when reused.
+        // purge_threshold 0 leaves purging to mem_trim (default).
+        size_t purge_threshold;
+        unsigned int purge_decay_ms;
+        mem_purge_mode_t purge_mode;
+
+        // Times every mem_alloc, mem_free and mem_resize into histograms
+        // read by mem_latency_snapshot. Each thread records into one of a
+        // fixed set of shards with relaxed atomic adds, never taking a lock.
+        mem_latency_clock_t latency_clock;
+    } mem_config_t;
+
+    /**
+     * An independent memory pool with its own memory, arenas, locks and thread
+     * caches. mem_init_ex, mem_alloc, mem_free, mem_resize and mem_deinit
+     * operate on a single default pool; the mem_pool_* functions do the same
+     * on an explicit pool, so subsystems can keep their allocations apart.
+     */
+    typedef struct mem_pool mem_pool_t;
+
     /**
      * Initializes the memory manager with a specified size of memory pool.
      * The memory pool could be any data structure, for instance, a large array
@@ -18,16 +148,134 @@ extern "C"
      */
     void mem_init(size_t size);
 
+    /**
+     * Initializes the memory manager as described by `config`. mem_init(size)
+     * is equivalent to calling this with only `size` set.
+     *
+     * With MEM_BACKEND_TAGS each block carries an 8-byte header and block sizes
+     * are rounded up to 16 bytes, so fewer payload bytes fit in a pool of the
+     * same size than with the list backend. MEM_BACKEND_BUDDY rounds every
+     * request up to a power of two (at least 16 bytes). MEM_BACKEND_TLSF uses
+     * the same block layout as MEM_BACKEND_TAGS but may fail a request that
+     * only an exact-fit search would satisfy, in exchange for bounded latency.
+     *
+     * @param config The pool configuration.
+     */
+    void mem_init_ex(const mem_config_t *config);
+
+    /**
+     * Outcome of mem_init_file. MEM_FILE_MOVED is or'ed into the others.
+     */
+    typedef enum
+    {
+        MEM_FILE_CREATED = 0,   // A new pool was set up in the file
+        MEM_FILE_ATTACHED = 1,  // The pool a clean shutdown left in the file was taken over
+        MEM_FILE_RECOVERED = 2, // The pool was taken over after a crash: its block map was rebuilt, data may be half-written
+        MEM_FILE_MOVED = 4      // The pool could not be mapped at its previous address: pointers stored in it are stale
+    } mem_file_status_t;
+
+    /**
+     * Initializes the memory manager with a pool kept in the file at `path`,
+     * so that a restarted process can pick up where the last one left off.
+     * The file is mapped shared; the pool runs MEM_BACKEND_TAGS, whose block
+     * metadata lives in the pool as offsets, in a single arena without thread
+     * caches. An existing pool file is reattached as it is, without walking
+     * the heap, unless the process that had it open did not get to
+     * mem_deinit. Data structures are found again through named roots (see
+     * mem_set_root); links between blocks survive a move when stored as
+     * offsets (see mem_offset_of). Only one pool may use the file at a time:
+     * the file is locked until mem_deinit, and opening it while another
+     * process (or another pool in this one) holds it fails.
+     *
+     * @param path The pool file, created if it does not exist or is empty.
+     * @param size Size of a new pool; an existing pool keeps its size.
+     * @return A mem_file_status_t, or -1 if the file is in use, could not be mapped or does not hold an intact pool.
+     */
+    int mem_init_file(const char *path, size_t size);
+
+    /**
+     * Initializes the memory manager with a pool in shared memory that
+     * several processes allocate from and free into at once. The first
+     * process to name a POSIX shared memory object creates the pool in it;
+     * the others attach to it, whatever `size` they pass. With a NULL name
+     * the pool is in anonymous shared memory, shared with the processes
+     * forked after this call. As with mem_init_file the pool runs
+     * MEM_BACKEND_TAGS in a single arena without thread caches; its lock is a
+     * process-shared robust mutex in the shared memory, and when a process
+     * dies holding it the next one to take it rebuilds the block map. The
+     * pool is mapped at a different address in every unrelated process, so
+     * blocks should refer to each other by offset (see mem_offset_of) and be
+     * found through roots (see mem_set_root). mem_stats counts occupancy
+     * over all processes, operations only for the calling one. The shared
+     * memory object outlives the processes until it is removed with shm_unlink.
+     *
+     * @param name The shared memory object, e.g. "/workers", or NULL.
+     * @param size Size of a new pool.
+     * @return MEM_FILE_CREATED or MEM_FILE_ATTACHED, or -1 on failure.
+     */
+    int mem_init_shared(const char *name, size_t size);
+
+    /**
+     * Names a block of a file-backed or shared pool, so that a later process can find
+     * it with mem_get_root. Up to 16 names of at most 47 characters.
+     *
+     * @param name The name of the root.
+     * @param block A block of the pool, or NULL to drop the name.
+     * @return 0, or -1 if the pool is neither file-backed nor shared, `block` is not in it or there is no room for the name.
+     */
+    int mem_set_root(const char *name, void *block);
+
+    /**
+     * Looks up a block named with mem_set_root, in this or an earlier process.
+     *
+     * @param name The name of the root.
+     * @return The block, or NULL if there is no root of that name.
+     */
+    void *mem_get_root(const char *name);
+
+    /**
+     * Turns a pointer into the pool into an offset from its start, which stays
+     * valid when a file-backed pool is mapped at another address.
+     *
+     * @param ptr A pointer into the pool, or NULL.
+     * @return The offset, never 0 for a pointer into the pool; 0 for NULL.
+     */
+    size_t mem_offset_of(const void *ptr);
+
+    /**
+     * Turns an offset from mem_offset_of back into a pointer.
+     *
+     * @param offset The offset, or 0.
+     * @return The pointer; NULL for 0.
+     */
+    void *mem_ptr_at(size_t offset);
+
     /**
      * Allocates a block of memory of the specified size. This function finds a
      * suitable block in the pool, marks it as allocated, and returns a pointer
      * to the start of the allocated block.
      *
+     * The block is aligned to mem_config_t.alignment, by default to
+     * alignof(max_align_t), so it can hold any object.
+     *
      * @param size The size of the memory block to allocate.
      * @return A pointer to the allocated memory block, or NULL if allocation fails.
      */
     void *mem_alloc(size_t size);
 
+    /**
+     * Allocates a block of memory whose address is a multiple of `align`, for
+     * instance 64 for a cache line or 32 for AVX loads. The block is freed with
+     * mem_free like any other; mem_resize keeps only the pool's default
+     * alignment. MEM_BACKEND_BUDDY cannot align beyond the alignment of its
+     * arena: 4096 bytes for a single arena, 64 when the pool is split.
+     *
+     * @param size The size of the memory block to allocate.
+     * @param align The required alignment, a power of two.
+     * @return A pointer to the allocated memory block, or NULL if allocation fails or `align` is invalid.
+     */
+    void *mem_alloc_aligned(size_t size, size_t align);
+
     /**
      * Frees the specified block of memory. This function marks the block as free
      * within the memory manager's data structure.
@@ -36,9 +284,38 @@ extern "C"
      */
     void mem_free(void *block);
 
+    /**
+     * Allocates `count` blocks of `size` bytes each, taking the pool lock
+     * once for as many of them as one arena can supply. Where one free block
+     * holds them all, the blocks are carved out of it back to back in
+     * address order; otherwise (and always with MEM_BACKEND_BUDDY) they are
+     * placed one by one. Thread caches are bypassed.
+     *
+     * @param size The size of every block.
+     * @param count The number of blocks to allocate.
+     * @param blocks Receives the blocks; must have room for `count` pointers.
+     * @return The number of blocks allocated, stored in blocks[0] onwards;
+     *         less than `count` if the pool ran out of room.
+     */
+    size_t mem_alloc_batch(size_t size, size_t count, void **blocks);
+
+    /**
+     * Frees `count` blocks, taking each lock once per run of blocks that
+     * share it. The blocks are freed in address order so that neighbours
+     * merge; `blocks` is sorted in the process. Thread caches are bypassed:
+     * the blocks go straight back to the pool.
+     *
+     * @param blocks The blocks to free.
+     * @param count The number of blocks.
+     */
+    void mem_free_batch(void **blocks, size_t count);
+
     /**
      * Changes the size of an existing memory block, possibly moving it to accommodate
      * the new size. It may also shrink the block if the new size is smaller than the current size.
+     * A block grows in place when the space after it is free, and shrinking hands
+     * the tail back to the pool without moving the block; data is only copied
+     * when the block has to move.
      *
      * @param block A pointer to the memory block to resize.
      * @param size The new size of the memory block.
@@ -46,6 +323,212 @@ extern "C"
      */
     void *mem_resize(void *block, size_t size);
 
+    /**
+     * Hands the pages of all free memory in the pool back to the OS, so that
+     * a long-running process does not keep its peak resident set. Blocks
+     * cached by the calling thread are returned to the pool first; those
+     * cached by other threads stay resident.
+     *
+     * @return The number of bytes handed back.
+     */
+    size_t mem_trim();
+
+    /**
+     * A snapshot of a pool's occupancy and activity, filled in by mem_stats.
+     * Blocks held by thread caches, slabs and regions count as in use.
+     */
+    typedef struct mem_stats
+    {
+        size_t pool_size;          // Bytes the pool spans, including chunks it has grown by
+        size_t bytes_in_use;       // Bytes in allocated blocks, including block headers and padding
+        size_t bytes_free;         // Bytes in free blocks
+        size_t peak_bytes_in_use;  // Highest bytes_in_use, per arena; an upper bound with several arenas
+        size_t blocks_in_use;      // Number of allocated blocks
+        size_t free_blocks;        // Number of free blocks
+        size_t largest_free_block; // Size of the largest free block, an upper bound for one request
+        double fragmentation;      // 1 - largest_free_block / bytes_free: 0 when all free memory is one block
+
+        uint64_t allocs;        // Successful allocations, batch and aligned ones included
+        uint64_t frees;         // Successful frees
+        uint64_t resizes;       // Successful resizes, in place or not
+        uint64_t failed_allocs; // Allocations and resizes that found no room
+    } mem_stats_t;
+
+    /**
+     * Reports statistics of the pool. The counters are kept up to date as
+     * the pool is used, so this is cheap enough to call in production; only
+     * the largest free block is searched for, among the largest free blocks.
+     *
+     * @param stats Receives the statistics; all zero if the pool is not initialized.
+     */
+    void mem_stats(mem_stats_t *stats);
+
+    /**
+     * One block of the pool, as reported by mem_walk.
+     */
+    typedef struct mem_block_info
+    {
+        size_t offset; // Offset in the pool; the chunks of a grown pool count as following the initial memory
+        void *address; // Start of the block, including any header
+        size_t size;   // Size of the block, including its header and padding
+        int is_free;   // 1 if the block is free, 0 if it is allocated
+        int arena;     // Arena holding the block; the chunks of a grown pool are numbered after the arenas
+    } mem_block_info_t;
+
+    typedef void (*mem_walk_fn)(const mem_block_info_t *block, void *ctx);
+
+    /**
+     * Reports every block of the pool, allocated or free, in address order
+     * within each arena. The blocks of an arena are copied under its lock and
+     * reported once it is released, so each arena is seen in a consistent
+     * state and `fn` may use the pool itself. Blocks held by thread caches,
+     * slabs and regions count as allocated.
+     *
+     * @param fn Called with every block.
+     * @param ctx Passed on to `fn`.
+     * @return 0, or -1 if the pool is not initialized or the copy could not be allocated.
+     */
+    int mem_walk(mem_walk_fn fn, void *ctx);
+
+    /**
+     * Writes the block map of the pool to a CSV file for offline analysis,
+     * e.g. with heap_map: a comment line naming the backend and pool size,
+     * the header "arena,offset,size,state", then one line per block as
+     * reported by mem_walk, state being "used" or "free".
+     *
+     * @param path The file to write.
+     * @return 0, or -1 if the pool is not initialized or the file could not be written.
+     */
+    int mem_dump(const char *path);
+
+    /**
+     * Operations whose arena lock acquisitions are told apart by the lock
+     * statistics. MEM_LOCK_OTHER covers mem_trim and mem_stats.
+     */
+    typedef enum
+    {
+        MEM_LOCK_ALLOC = 0,
+        MEM_LOCK_FREE,
+        MEM_LOCK_RESIZE,
+        MEM_LOCK_OTHER,
+        MEM_LOCK_OPS // Number of operation types
+    } mem_lock_op_t;
+
+    /**
+     * Lock statistics for one operation type, summed over all arenas. Only
+     * collected when the library is built with -DMEM_LOCK_STATS; otherwise
+     * the locks are taken without any bookkeeping.
+     */
+    typedef struct mem_lock_stats
+    {
+        uint64_t acquires;    // Lock acquisitions
+        uint64_t contended;   // Acquisitions that had to wait for another thread
+        uint64_t wait_ns;     // Total time spent waiting
+        uint64_t max_wait_ns; // Longest single wait
+        uint64_t hold_ns;     // Total time the lock was held
+        uint64_t max_hold_ns; // Longest single hold
+    } mem_lock_stats_t;
+
+    /**
+     * Reports the arena lock statistics of the pool, one entry per mem_lock_op_t.
+     * With MEM_LOCK_STATS they are also printed to stderr when the pool is torn down.
+     *
+     * @param stats Receives MEM_LOCK_OPS entries.
+     * @return 0, or -1 (with all entries zero) if the library was built without MEM_LOCK_STATS.
+     */
+    int mem_lock_stats(mem_lock_stats_t stats[MEM_LOCK_OPS]);
+
+    /**
+     * Prints the arena lock statistics of the pool as a table.
+     *
+     * @param out The stream to print to.
+     */
+    void mem_lock_stats_print(FILE *out);
+
+    /**
+     * Operations timed by the latency histograms. Batch operations are not
+     * timed as a whole; aligned allocations count as MEM_OP_ALLOC.
+     */
+    typedef enum
+    {
+        MEM_OP_ALLOC = 0,
+        MEM_OP_FREE,
+        MEM_OP_RESIZE,
+        MEM_OPS // Number of operation types
+    } mem_op_t;
+
+    // Size classes of the latency histograms: class i holds requests of at
+    // most 16 << i bytes (frees go by the size of the block), the last class
+    // everything larger.
+#define MEM_HIST_SIZE_CLASSES 12
+
+    // Log-bucketed latencies: exact below 8 ns, then 8 buckets per power of
+    // two, so a bucket is within 12.5% of any latency in it. Latencies of
+    // 2^36 ns (about a minute) and more share the last bucket.
+#define MEM_HIST_BUCKETS 272
+
+    /**
+     * Latency histograms of a pool, in nanoseconds, per operation and size class.
+     * About 80 KiB, so better not put on a small stack.
+     */
+    typedef struct mem_histogram
+    {
+        uint64_t counts[MEM_OPS][MEM_HIST_SIZE_CLASSES][MEM_HIST_BUCKETS];
+    } mem_histogram_t;
+
+    /**
+     * Adds up the latency histograms of the pool recorded so far.
+     *
+     * @param hist Receives the histograms.
+     * @return 0, or -1 (with `hist` all zero) if the pool does not record latencies.
+     */
+    int mem_latency_snapshot(mem_histogram_t *hist);
+
+    /**
+     * Clears the latency histograms of the pool. Operations that finish while
+     * the histograms are being cleared may or may not be counted.
+     */
+    void mem_latency_reset();
+
+    /**
+     * Adds the counts of one histogram to another, e.g. to combine the
+     * snapshots of several pools or processes.
+     *
+     * @param into The histogram added to.
+     * @param from The histogram added.
+     */
+    void mem_histogram_merge(mem_histogram_t *into, const mem_histogram_t *from);
+
+    /**
+     * Counts the operations recorded in a histogram.
+     *
+     * @param hist The histogram to read.
+     * @param op The operation.
+     * @param size_class A size class, or -1 for all of them.
+     * @return The number of operations.
+     */
+    uint64_t mem_histogram_count(const mem_histogram_t *hist, mem_op_t op, int size_class);
+
+    /**
+     * Looks up a latency percentile in a histogram.
+     *
+     * @param hist The histogram to read.
+     * @param op The operation.
+     * @param size_class A size class, or -1 for all of them.
+     * @param percentile The percentile, from 0 to 100, e.g. 99.9.
+     * @return The highest latency, in ns, in the bucket holding the percentile; 0 if nothing was recorded.
+     */
+    uint64_t mem_histogram_percentile(const mem_histogram_t *hist, mem_op_t op, int size_class, double percentile);
+
+    /**
+     * Prints the count, p50, p99, p99.9 and maximum latency of every
+     * operation, over all size classes.
+     *
+     * @param hist The histogram to print.
+     * @param out The stream to print to.
+     */
+    void mem_histogram_print(const mem_histogram_t *hist, FILE *out);
+
     /**
      * Frees up the entire memory pool that was initially allocated by mem_init.
      * This function should be called to clean up the memory manager resources before
@@ -53,6 +536,309 @@ extern "C"
      */
     void mem_deinit();
 
+    /**
+     * Creates a memory pool as described by `config`, independent of the
+     * default pool and of any other pool.
+     *
+     * @param config The pool configuration.
+     * @return The new pool, or NULL if it could not be set up.
+     */
+    mem_pool_t *mem_pool_create(const mem_config_t *config);
+
+    /**
+     * Like mem_init_file, as an independent pool.
+     *
+     * @param path The pool file.
+     * @param size Size of a new pool.
+     * @param status Receives the mem_file_status_t, or -1; may be NULL.
+     * @return The pool, or NULL if it could not be set up.
+     */
+    mem_pool_t *mem_pool_create_file(const char *path, size_t size, int *status);
+
+    /**
+     * Like mem_init_shared, as an independent pool.
+     *
+     * @param name The shared memory object, or NULL for anonymous shared memory.
+     * @param size Size of a new pool.
+     * @param status Receives the mem_file_status_t, or -1; may be NULL.
+     * @return The pool, or NULL if it could not be set up.
+     */
+    mem_pool_t *mem_pool_create_shared(const char *name, size_t size, int *status);
+
+    /**
+     * Like mem_set_root, for `pool`.
+     *
+     * @param pool A file-backed or shared pool.
+     * @param name The name of the root.
+     * @param block A block of the pool, or NULL to drop the name.
+     * @return 0, or -1 on failure.
+     */
+    int mem_pool_set_root(mem_pool_t *pool, const char *name, void *block);
+
+    /**
+     * Like mem_get_root, for `pool`.
+     *
+     * @param pool A file-backed or shared pool.
+     * @param name The name of the root.
+     * @return The block, or NULL.
+     */
+    void *mem_pool_get_root(mem_pool_t *pool, const char *name);
+
+    /**
+     * Like mem_offset_of, for `pool`.
+     *
+     * @param pool The pool `ptr` points into.
+     * @param ptr A pointer into the pool, or NULL.
+     * @return The offset, or 0 for NULL.
+     */
+    size_t mem_pool_offset_of(mem_pool_t *pool, const void *ptr);
+
+    /**
+     * Like mem_ptr_at, for `pool`.
+     *
+     * @param pool The pool the offset is in.
+     * @param offset The offset, or 0.
+     * @return The pointer, or NULL for 0.
+     */
+    void *mem_pool_ptr_at(mem_pool_t *pool, size_t offset);
+
+    /**
+     * Like mem_alloc, but allocates from `pool`.
+     *
+     * @param pool The pool to allocate from.
+     * @param size The size of the memory block to allocate.
+     * @return A pointer to the allocated memory block, or NULL if allocation fails.
+     */
+    void *mem_pool_alloc(mem_pool_t *pool, size_t size);
+
+    /**
+     * Like mem_alloc_aligned, but allocates from `pool`.
+     *
+     * @param pool The pool to allocate from.
+     * @param size The size of the memory block to allocate.
+     * @param align The required alignment, a power of two.
+     * @return A pointer to the allocated memory block, or NULL if allocation fails or `align` is invalid.
+     */
+    void *mem_pool_alloc_aligned(mem_pool_t *pool, size_t size, size_t align);
+
+    /**
+     * Like mem_free, for a block allocated from `pool`.
+     *
+     * @param pool The pool the block was allocated from.
+     * @param block A pointer to the memory block to free.
+     */
+    void mem_pool_free(mem_pool_t *pool, void *block);
+
+    /**
+     * Like mem_alloc_batch, from `pool`.
+     *
+     * @param pool The pool to allocate from.
+     * @param size The size of every block.
+     * @param count The number of blocks to allocate.
+     * @param blocks Receives the blocks; must have room for `count` pointers.
+     * @return The number of blocks allocated.
+     */
+    size_t mem_pool_alloc_batch(mem_pool_t *pool, size_t size, size_t count, void **blocks);
+
+    /**
+     * Like mem_free_batch, for blocks allocated from `pool`.
+     *
+     * @param pool The pool the blocks were allocated from.
+     * @param blocks The blocks to free; sorted in the process.
+     * @param count The number of blocks.
+     */
+    void mem_pool_free_batch(mem_pool_t *pool, void **blocks, size_t count);
+
+    /**
+     * Like mem_resize, for a block allocated from `pool`. The block stays in `pool`.
+     *
+     * @param pool The pool the block was allocated from.
+     * @param block A pointer to the memory block to resize.
+     * @param size The new size of the memory block.
+     * @return A pointer to the resized memory block, or NULL if the resizing fails.
+     */
+    void *mem_pool_resize(mem_pool_t *pool, void *block, size_t size);
+
+    /**
+     * Like mem_trim, for `pool`.
+     *
+     * @param pool The pool to trim.
+     * @return The number of bytes handed back.
+     */
+    size_t mem_pool_trim(mem_pool_t *pool);
+
+    /**
+     * Like mem_stats, for `pool`.
+     *
+     * @param pool The pool to report on.
+     * @param stats Receives the statistics.
+     */
+    void mem_pool_stats(mem_pool_t *pool, mem_stats_t *stats);
+
+    /**
+     * Like mem_walk, for `pool`.
+     *
+     * @param pool The pool to walk.
+     * @param fn Called with every block.
+     * @param ctx Passed on to `fn`.
+     * @return 0, or -1 on failure.
+     */
+    int mem_pool_walk(mem_pool_t *pool, mem_walk_fn fn, void *ctx);
+
+    /**
+     * Like mem_dump, for `pool`.
+     *
+     * @param pool The pool to dump.
+     * @param path The file to write.
+     * @return 0, or -1 on failure.
+     */
+    int mem_pool_dump(mem_pool_t *pool, const char *path);
+
+    /**
+     * Like mem_lock_stats, for `pool`.
+     *
+     * @param pool The pool to report on.
+     * @param stats Receives MEM_LOCK_OPS entries.
+     * @return 0, or -1 if the library was built without MEM_LOCK_STATS.
+     */
+    int mem_pool_lock_stats(mem_pool_t *pool, mem_lock_stats_t stats[MEM_LOCK_OPS]);
+
+    /**
+     * Like mem_lock_stats_print, for `pool`.
+     *
+     * @param pool The pool to report on.
+     * @param out The stream to print to.
+     */
+    void mem_pool_lock_stats_print(mem_pool_t *pool, FILE *out);
+
+    /**
+     * Like mem_latency_snapshot, for `pool`.
+     *
+     * @param pool The pool to report on.
+     * @param hist Receives the histograms.
+     * @return 0, or -1 if the pool does not record latencies.
+     */
+    int mem_pool_latency_snapshot(mem_pool_t *pool, mem_histogram_t *hist);
+
+    /**
+     * Like mem_latency_reset, for `pool`.
+     *
+     * @param pool The pool whose histograms to clear.
+     */
+    void mem_pool_latency_reset(mem_pool_t *pool);
+
+    /**
+     * Releases `pool` and all memory allocated from it. No other thread may
+     * be using the pool at the time.
+     *
+     * @param pool The pool to destroy.
+     */
+    void mem_pool_destroy(mem_pool_t *pool);
+
+    /**
+     * A slab of fixed-size objects whose pages are carved out of the memory pool.
+     * Allocation and release of objects are lock-free.
+     */
+    typedef struct mem_slab mem_slab_t;
+
+    /**
+     * Creates a slab for objects of `obj_size` bytes. Pages are taken from the
+     * pool with mem_alloc as the slab grows, so the pool must be initialized
+     * first and every slab must be destroyed before mem_deinit.
+     *
+     * @param obj_size Size of each object; rounded up to a multiple of 8.
+     * @return The new slab, or NULL on failure.
+     */
+    mem_slab_t *mem_slab_create(size_t obj_size);
+
+    /**
+     * Like mem_slab_create, but takes the slab's pages from `pool`. The slab
+     * must be destroyed before the pool.
+     *
+     * @param pool The pool to take pages from.
+     * @param obj_size Size of each object; rounded up to a multiple of 8.
+     * @return The new slab, or NULL on failure.
+     */
+    mem_slab_t *mem_pool_slab_create(mem_pool_t *pool, size_t obj_size);
+
+    /**
+     * Returns the size of a MEM_BACKEND_LIST pool, with the default
+     * alignment, that a slab can take enough pages from for `count` objects
+     * of `obj_size` bytes. Every page carries a header and may end in unused
+     * bytes, so this is more than count * obj_size.
+     *
+     * @param obj_size Size of each object.
+     * @param count The number of objects the slab must be able to hold at once.
+     * @return The pool size in bytes.
+     */
+    size_t mem_slab_pool_size(size_t obj_size, size_t count);
+
+    /**
+     * Allocates one object from the slab, growing it by a page if no free object is left.
+     *
+     * @param slab The slab to allocate from.
+     * @return A pointer to the object, or NULL if the pool is exhausted.
+     */
+    void *mem_slab_alloc(mem_slab_t *slab);
+
+    /**
+     * Returns an object to the slab it was allocated from. Double frees are not detected.
+     *
+     * @param slab The slab that owns the object.
+     * @param obj The object to free.
+     */
+    void mem_slab_free(mem_slab_t *slab, void *obj);
+
+    /**
+     * Returns all pages of the slab to the pool. Objects from the slab must not be used afterwards.
+     *
+     * @param slab The slab to destroy.
+     */
+    void mem_slab_destroy(mem_slab_t *slab);
+
+    /**
+     * A region for request-scoped allocation. Objects are allocated by
+     * bumping a pointer through memory taken from the pool and are never
+     * freed individually; releasing the region gives all of them back at
+     * once. A region must only be used by one thread at a time.
+     */
+    typedef struct mem_region mem_region_t;
+
+    /**
+     * Starts a region in the default pool. The pool must be initialized first
+     * and every region must be released before mem_deinit.
+     *
+     * @return The new region, or NULL on failure.
+     */
+    mem_region_t *mem_region_begin();
+
+    /**
+     * Like mem_region_begin, but takes the region's memory from `pool`. The
+     * region must be released before the pool is destroyed.
+     *
+     * @param pool The pool to take memory from.
+     * @return The new region, or NULL on failure.
+     */
+    mem_region_t *mem_pool_region_begin(mem_pool_t *pool);
+
+    /**
+     * Allocates an object from the region, 16-byte aligned. The region
+     * grows, in place where the pool allows, when it is used up.
+     *
+     * @param region The region to allocate from.
+     * @param size The size of the object in bytes.
+     * @return A pointer to the object, or NULL if the pool is exhausted.
+     */
+    void *mem_region_alloc(mem_region_t *region, size_t size);
+
+    /**
+     * Returns all memory of the region to the pool. Objects allocated from
+     * the region must not be used afterwards.
+     *
+     * @param region The region to release.
+     */
+    void mem_region_release(mem_region_t *region);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,326 @@
+// memory_manager_blocks.c
+//
+// Boundary-tag block layer, see memory_manager_blocks.h. Every header change
+// that splits a block writes the new tail's header before the block shrinks,
+// so a region abandoned halfway through an operation can still be walked
+// block by block (see bt_rebuild).
+
+#include <stdint.h>
+#include "memory_manager_blocks.h"
+
+static inline void bt_set_footer(const BtBlocks* blocks, uint64_t off, size_t size) {
+    *(size_t*)(blocks->base + off + size - BT_HEADER_SIZE) = size;
+}
+
+// Counts a free block and files it in the backend's index
+static void bt_file(const BtBlocks* blocks, uint64_t off) {
+    blocks->area->free_bytes += bt_size(blocks, off);
+    blocks->area->free_blocks++;
+    blocks->index->insert(blocks->heap, off);
+}
+
+// Takes a free block out of the backend's index and the counters
+static void bt_unfile(const BtBlocks* blocks, uint64_t off) {
+    blocks->index->remove(blocks->heap, off);
+    blocks->area->free_bytes -= bt_size(blocks, off);
+    blocks->area->free_blocks--;
+}
+
+// Records a new high-water mark of allocated bytes
+static inline void bt_note_peak(const BtBlocks* blocks) {
+    BtArea* area = blocks->area;
+    uint64_t used = area->end - area->first - area->free_bytes;
+    if (used > area->peak_used) {
+        area->peak_used = used;
+    }
+}
+
+// Translates a payload pointer to its block offset, or 0 if it is not the
+// payload of one of our blocks. A pointer into the middle of a block finds
+// arbitrary bytes where its header would be, so the header has to agree with
+// the region around it: a size that stays inside the region, the next
+// block's BT_PREV_ALLOCATED flag matching BT_ALLOCATED and, for a free block,
+// a footer repeating the size.
+static uint64_t bt_offset_of(const BtBlocks* blocks, void* ptr) {
+    char* payload = (char*)ptr;
+    char* first = blocks->base + blocks->area->first + BT_HEADER_SIZE;
+    char* end = blocks->base + blocks->area->end;
+
+    if (payload < first || payload >= end || (size_t)(payload - first) % BT_ALIGN != 0) {
+        return 0;
+    }
+    uint64_t off = (uint64_t)(payload - blocks->base) - BT_HEADER_SIZE;
+
+    size_t header = *bt_header(blocks, off);
+    size_t size = header & ~BT_FLAGS;
+    if (size < BT_MIN_BLOCK || size > blocks->area->end - off) {
+        return 0;
+    }
+    int allocated = (header & BT_ALLOCATED) != 0;
+    if (allocated != ((*bt_header(blocks, off + size) & BT_PREV_ALLOCATED) != 0)) {
+        return 0;
+    }
+    if (!allocated && *(size_t*)(blocks->base + off + size - BT_HEADER_SIZE) != size) {
+        return 0;
+    }
+    return off;
+}
+
+void bt_init(const BtBlocks* blocks, uint64_t first, size_t span) {
+    BtArea* area = blocks->area;
+    size_t avail = (span - first - BT_HEADER_SIZE) & ~BT_FLAGS;
+
+    area->first = first;
+    area->end = first + avail;
+    area->free_bytes = 0;
+    area->free_blocks = 0;
+    area->used_blocks = 0;
+    area->peak_used = 0;
+
+    // The epilogue is a zero-sized allocated block that stops forward coalescing
+    *bt_header(blocks, area->end) = BT_ALLOCATED;
+
+    *bt_header(blocks, first) = avail | BT_PREV_ALLOCATED;
+    bt_set_footer(blocks, first, avail);
+    bt_file(blocks, first);
+}
+
+int bt_rebuild(const BtBlocks* blocks) {
+    BtArea* area = blocks->area;
+    area->free_bytes = 0;
+    area->free_blocks = 0;
+    area->used_blocks = 0;
+
+    uint64_t prev_free = 0; // The free block just before `off`, if any
+    uint64_t off = area->first;
+    while (off < area->end) {
+        size_t block_size = bt_size(blocks, off);
+        if (block_size == 0 || block_size > area->end - off) {
+            return -1;
+        }
+
+        if (!(*bt_header(blocks, off) & BT_ALLOCATED)) {
+            if (prev_free) {
+                bt_unfile(blocks, prev_free);
+                block_size += bt_size(blocks, prev_free);
+                off = prev_free;
+            }
+            // The block before a free block is always allocated
+            *bt_header(blocks, off) = block_size | BT_PREV_ALLOCATED;
+            bt_set_footer(blocks, off, block_size);
+            bt_file(blocks, off);
+            prev_free = off;
+        } else {
+            *bt_header(blocks, off) = block_size | BT_ALLOCATED | (prev_free ? 0 : BT_PREV_ALLOCATED);
+            area->used_blocks++;
+            prev_free = 0;
+        }
+        off += block_size;
+    }
+    if (off != area->end) {
+        return -1;
+    }
+    *bt_header(blocks, area->end) = BT_ALLOCATED | (prev_free ? 0 : BT_PREV_ALLOCATED);
+    return 0;
+}
+
+// Allocates `asize` bytes from the free block at `off`, which has already
+// been taken out of the index, and returns the payload
+static void* bt_place(const BtBlocks* blocks, uint64_t off, size_t asize) {
+    size_t block_size = bt_size(blocks, off);
+    size_t prev_flag = *bt_header(blocks, off) & BT_PREV_ALLOCATED;
+
+    if (block_size - asize >= BT_MIN_BLOCK) {
+        // Split: the tail stays free. Its header is written before the block
+        // shrinks, so the region stays walkable.
+        uint64_t rest = off + asize;
+        *bt_header(blocks, rest) = (block_size - asize) | BT_PREV_ALLOCATED;
+        bt_set_footer(blocks, rest, block_size - asize);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        *bt_header(blocks, off) = asize | BT_ALLOCATED | prev_flag;
+        bt_file(blocks, rest);
+    } else {
+        *bt_header(blocks, off) = block_size | BT_ALLOCATED | prev_flag;
+        *bt_header(blocks, off + block_size) |= BT_PREV_ALLOCATED;
+    }
+
+    return blocks->base + off + BT_HEADER_SIZE;
+}
+
+void* bt_take(const BtBlocks* blocks, uint64_t off, size_t asize) {
+    bt_unfile(blocks, off);
+    void* ptr = bt_place(blocks, off, asize);
+    blocks->area->used_blocks++;
+    bt_note_peak(blocks);
+    return ptr;
+}
+
+// The padding in front of the aligned payload, at least BT_MIN_BLOCK bytes,
+// is split off as a free block of its own
+void* bt_take_aligned(const BtBlocks* blocks, uint64_t off, size_t asize, size_t align) {
+    bt_unfile(blocks, off);
+
+    size_t pad = -(uintptr_t)(blocks->base + off + BT_HEADER_SIZE) & (align - 1);
+    if (pad) {
+        if (pad < BT_MIN_BLOCK) {
+            pad += align;
+        }
+        // The block before a free block is always allocated
+        size_t block_size = bt_size(blocks, off);
+        *bt_header(blocks, off + pad) = block_size - pad; // Before the split, as in bt_place
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        *bt_header(blocks, off) = pad | (*bt_header(blocks, off) & BT_PREV_ALLOCATED);
+        bt_set_footer(blocks, off, pad);
+        bt_file(blocks, off);
+        off += pad;
+    }
+
+    void* ptr = bt_place(blocks, off, asize);
+    blocks->area->used_blocks++;
+    bt_note_peak(blocks);
+    return ptr;
+}
+
+// The run is placed as one block first; the headers inside it are written
+// before its first block shrinks, as in bt_place. The last block keeps
+// whatever was too small to split off.
+void bt_take_run(const BtBlocks* blocks, uint64_t off, size_t asize, size_t count, void** ptrs) {
+    size_t prev_flag = *bt_header(blocks, off) & BT_PREV_ALLOCATED;
+    bt_unfile(blocks, off);
+    bt_place(blocks, off, asize * count);
+
+    size_t total = bt_size(blocks, off);
+    for (size_t i = count - 1; i > 0; i--) {
+        uint64_t piece = off + i * asize;
+        size_t size = i == count - 1 ? total - i * asize : asize;
+        *bt_header(blocks, piece) = size | BT_ALLOCATED | BT_PREV_ALLOCATED;
+        ptrs[i] = blocks->base + piece + BT_HEADER_SIZE;
+    }
+    if (count > 1) {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        *bt_header(blocks, off) = asize | BT_ALLOCATED | prev_flag;
+    }
+    ptrs[0] = blocks->base + off + BT_HEADER_SIZE;
+
+    blocks->area->used_blocks += count;
+    bt_note_peak(blocks);
+}
+
+int bt_free(const BtBlocks* blocks, void* ptr) {
+    uint64_t off = bt_offset_of(blocks, ptr);
+    if (!off) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    size_t header = *bt_header(blocks, off);
+    if (!(header & BT_ALLOCATED)) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+
+    size_t size = header & ~BT_FLAGS;
+
+    // Merge with the following block if it is free
+    uint64_t next = off + size;
+    if (!(*bt_header(blocks, next) & BT_ALLOCATED)) {
+        bt_unfile(blocks, next);
+        size += bt_size(blocks, next);
+    }
+
+    // Merge with the preceding block, found through its footer
+    uint64_t freed = off;
+    if (!(header & BT_PREV_ALLOCATED)) {
+        size_t prev_size = *(size_t*)(blocks->base + off - BT_HEADER_SIZE);
+        off -= prev_size;
+        bt_unfile(blocks, off);
+        size += prev_size;
+    }
+
+    // Two free blocks are never adjacent, so the block before is allocated
+    *bt_header(blocks, off) = size | BT_PREV_ALLOCATED;
+    bt_set_footer(blocks, off, size);
+    *bt_header(blocks, off + size) &= ~BT_PREV_ALLOCATED;
+    if (freed != off) {
+        // The freed block's header now lies inside the merged block. Cleared
+        // only after the merged header is written, so the region stays
+        // walkable, it can no longer pass for an allocated block if freed again.
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        *bt_header(blocks, freed) = 0;
+    }
+    bt_file(blocks, off);
+    blocks->area->used_blocks--;
+
+    return MEM_OK;
+}
+
+// Grows a block into the free block after it, or shrinks it by splitting off
+// its tail, without moving it
+int bt_resize(const BtBlocks* blocks, void* ptr, size_t size) {
+    uint64_t off = bt_offset_of(blocks, ptr);
+    if (!off) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    size_t header = *bt_header(blocks, off);
+    if (!(header & BT_ALLOCATED)) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    size_t asize = bt_request_size(blocks, size);
+    if (!asize) {
+        return MEM_ERR_NO_ROOM;
+    }
+
+    size_t total = header & ~BT_FLAGS;
+    uint64_t next = off + total;
+    size_t next_size = *bt_header(blocks, next) & BT_ALLOCATED ? 0 : bt_size(blocks, next);
+    if (total + next_size < asize) {
+        return MEM_ERR_NO_ROOM;
+    }
+    if (next_size) {
+        bt_unfile(blocks, next);
+        total += next_size;
+    }
+
+    // Place the request in the (possibly merged) block as if it were free,
+    // which hands any tail back to the index
+    *bt_header(blocks, off) = total | (header & BT_PREV_ALLOCATED);
+    bt_place(blocks, off, asize);
+    if (bt_size(blocks, off) < total) {
+        *bt_header(blocks, off + total) &= ~BT_PREV_ALLOCATED;
+    }
+    bt_note_peak(blocks);
+    return MEM_OK;
+}
+
+int bt_block_size(const BtBlocks* blocks, void* ptr, size_t* size) {
+    uint64_t off = bt_offset_of(blocks, ptr);
+    if (!off) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (!(*bt_header(blocks, off) & BT_ALLOCATED)) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    *size = bt_size(blocks, off) - BT_HEADER_SIZE;
+    return MEM_OK;
+}
+
+// The interior of a free block lies between its links and its footer
+void bt_free_run(const BtBlocks* blocks, uint64_t off, mem_run_fn fn, void* ctx) {
+    size_t skip = BT_HEADER_SIZE + sizeof(BtLinks);
+    fn(blocks->base + off + skip, bt_size(blocks, off) - skip - BT_HEADER_SIZE, ctx);
+}
+
+// Blocks follow each other from the first one up to the epilogue
+void bt_walk(const BtBlocks* blocks, mem_block_fn fn, void* ctx) {
+    for (uint64_t off = blocks->area->first; off < blocks->area->end; off += bt_size(blocks, off)) {
+        fn(bt_header(blocks, off), bt_size(blocks, off), !(*bt_header(blocks, off) & BT_ALLOCATED), ctx);
+    }
+}
+
+void bt_stats(const BtBlocks* blocks, mem_backend_stats* stats) {
+    BtArea* area = blocks->area;
+
+    stats->used_bytes = area->end - area->first - area->free_bytes;
+    stats->used_blocks = area->used_blocks;
+    stats->free_bytes = area->free_bytes;
+    stats->free_blocks = area->free_blocks;
+    stats->peak_used_bytes = area->peak_used;
+    stats->largest_free = 0;
+}
@@ -0,0 +1,125 @@
+// memory_manager_blocks.h
+//
+// Boundary-tag block layer shared by the tags and TLSF backends. Blocks lie
+// back to back in one region: an 8-byte header in front of every block holds
+// its size and the allocated/previous-allocated flags, and a free block also
+// carries a footer repeating the size plus two links in its payload. A
+// zero-sized allocated epilogue ends the region. Offsets are relative to a
+// base address the backend chooses, so the layout does not depend on where
+// the memory is mapped.
+//
+// The layer splits, merges, validates and walks blocks. Which free block
+// serves a request is left to the backend, which files free blocks in an
+// index of its own through BtIndex.
+#ifndef MEMORY_MANAGER_BLOCKS_H
+#define MEMORY_MANAGER_BLOCKS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "memory_manager_internal.h"
+
+#define BT_ALIGN 16                     // Block sizes and payloads are 16-byte aligned
+#define BT_HEADER_SIZE sizeof(size_t)   // Size of a block header (and of a footer)
+#define BT_MIN_BLOCK 32                 // Header + two links + footer
+#define BT_ALLOCATED ((size_t)1)        // Header flag: this block is allocated
+#define BT_PREV_ALLOCATED ((size_t)2)   // Header flag: the block before this one is allocated
+#define BT_FLAGS ((size_t)(BT_ALIGN - 1))
+
+// Bytes a region needs beyond `first` for one free block and the epilogue
+#define BT_MIN_SPAN (BT_MIN_BLOCK + BT_HEADER_SIZE)
+
+// Bounds and counters of a region, kept wherever the backend keeps its state
+typedef struct BtArea
+{
+    uint64_t first;       // Offset of the first block header, never 0
+    uint64_t end;         // Offset of the epilogue header
+    uint64_t free_bytes;  // Total size of the free blocks
+    uint64_t free_blocks; // Number of free blocks
+    uint64_t used_blocks; // Number of allocated blocks
+    uint64_t peak_used;   // Highest number of bytes allocated at once
+} BtArea;
+
+// Links stored in the payload of a free block, for the backend's index
+typedef struct BtLinks
+{
+    uint64_t prev;
+    uint64_t next;
+} BtLinks;
+
+// The backend's index of free blocks. insert is called once a free block's
+// header and footer are final; remove before they change.
+typedef struct BtIndex
+{
+    void (*insert)(void *heap, uint64_t off);
+    void (*remove)(void *heap, uint64_t off);
+} BtIndex;
+
+// A region as seen by one call into the layer
+typedef struct BtBlocks
+{
+    char *base;             // Block offsets are relative to this address
+    BtArea *area;
+    const BtIndex *index;
+    void *heap;             // The backend heap handed to the index
+} BtBlocks;
+
+static inline size_t *bt_header(const BtBlocks *blocks, uint64_t off)
+{
+    return (size_t *)(blocks->base + off);
+}
+
+static inline size_t bt_size(const BtBlocks *blocks, uint64_t off)
+{
+    return *bt_header(blocks, off) & ~BT_FLAGS;
+}
+
+static inline BtLinks *bt_links(const BtBlocks *blocks, uint64_t off)
+{
+    return (BtLinks *)(blocks->base + off + BT_HEADER_SIZE);
+}
+
+// Rounds a request up to a block size, header included; 0 if it can never fit
+static inline size_t bt_request_size(const BtBlocks *blocks, size_t size)
+{
+    if (size > blocks->area->end)
+        return 0;
+    size_t asize = (size + BT_HEADER_SIZE + BT_ALIGN - 1) & ~BT_FLAGS;
+    return asize < BT_MIN_BLOCK ? BT_MIN_BLOCK : asize;
+}
+
+// Lays out `span` bytes from the base, blocks starting at `first`, as one
+// free block. The caller has checked that span >= first + BT_MIN_SPAN.
+void bt_init(const BtBlocks *blocks, uint64_t first, size_t span);
+
+// Re-derives flags, footers, index and counters from the block sizes of a
+// region that may have been abandoned halfway through an operation, merging
+// free neighbours. The index must start out empty. Returns -1 if the sizes
+// do not add up.
+int bt_rebuild(const BtBlocks *blocks);
+
+// Allocates `asize` bytes (see bt_request_size) from the free block at `off`,
+// which is still filed in the index, and returns the payload
+void *bt_take(const BtBlocks *blocks, uint64_t off, size_t asize);
+
+// As bt_take, with the payload aligned to `align` (a power of two above
+// BT_ALIGN). The block at `off` must hold asize + align + BT_MIN_BLOCK bytes.
+void *bt_take_aligned(const BtBlocks *blocks, uint64_t off, size_t asize, size_t align);
+
+// Allocates `count` adjacent blocks of `asize` bytes from the free block at
+// `off`, which holds at least count * asize bytes, storing their payloads in
+// `ptrs`
+void bt_take_run(const BtBlocks *blocks, uint64_t off, size_t asize, size_t count, void **ptrs);
+
+int bt_free(const BtBlocks *blocks, void *ptr);                 // MEM_OK or MEM_ERR_*
+int bt_resize(const BtBlocks *blocks, void *ptr, size_t size);  // In place: MEM_OK or MEM_ERR_*
+int bt_block_size(const BtBlocks *blocks, void *ptr, size_t *size);
+
+// Reports the metadata-free interior of the free block at `off`
+void bt_free_run(const BtBlocks *blocks, uint64_t off, mem_run_fn fn, void *ctx);
+
+void bt_walk(const BtBlocks *blocks, mem_block_fn fn, void *ctx);
+
+// Fills in everything but largest_free, which depends on the index
+void bt_stats(const BtBlocks *blocks, mem_backend_stats *stats);
+
+#endif // MEMORY_MANAGER_BLOCKS_H
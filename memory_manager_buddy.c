@@ -0,0 +1,355 @@
+// memory_manager_buddy.c
+//
+// Binary buddy backend. Every block is a power of two in size, between
+// 2^BUDDY_MIN_ORDER and 2^BUDDY_MAX_ORDER bytes, and aligned to its size
+// relative to the start of the region. Allocation rounds the request up to
+// the next power of two and splits a larger free block in halves as needed;
+// freeing merges a block with its buddy, found at offset ^ size, for as long
+// as the buddy is free too. Both are O(log n) in the size of the region.
+//
+// A region that is not a power of two is covered by the largest aligned
+// power-of-two blocks that fit; the buddies of those blocks lie past the end
+// of the region and are never merged with.
+//
+// Free-list links live inside the free blocks. The state of every
+// minimum-sized slot (free or allocated block start and its order) is kept in
+// a byte array outside the pool, so the whole region is usable.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "memory_manager_internal.h"
+
+#define BUDDY_MIN_ORDER 4   // 16-byte blocks: room for the two free-list links
+#define BUDDY_MAX_ORDER 47
+#define BUDDY_NUM_ORDERS (BUDDY_MAX_ORDER + 1)
+#define BUDDY_NIL UINT64_MAX
+#define BUDDY_FREE 0x80     // State flag: a free block starts at this slot
+
+typedef struct BuddyHeap {
+    char* base;                          // Region start, aligned to the minimum block size
+    uint64_t size;                       // Bytes managed, a multiple of the minimum block size
+    uint8_t* state;                      // Per slot: 0 if no block starts here, else (order + 1) | BUDDY_FREE if free
+    uint64_t free_lists[BUDDY_NUM_ORDERS]; // Offset of the first free block of each order, BUDDY_NIL if none
+    uint64_t free_list_bitmap;           // Bit k set if free_lists[k] is non-empty
+    uint64_t free_bytes;                 // Total size of the blocks on the free lists
+    uint64_t free_blocks;                // Number of blocks on the free lists
+    uint64_t used_blocks;                // Number of allocated blocks
+    uint64_t peak_used;                  // Highest number of bytes allocated at once
+} BuddyHeap;
+
+// Free-list links stored in a free block
+typedef struct BuddyLinks {
+    uint64_t prev;
+    uint64_t next;
+} BuddyLinks;
+
+static inline BuddyLinks* buddy_links(BuddyHeap* heap, uint64_t off) {
+    return (BuddyLinks*)(heap->base + off);
+}
+
+static inline uint8_t* buddy_state(BuddyHeap* heap, uint64_t off) {
+    return &heap->state[off >> BUDDY_MIN_ORDER];
+}
+
+// Adds a free block of the given order to the head of its list
+static void buddy_list_insert(BuddyHeap* heap, uint64_t off, int order) {
+    BuddyLinks* links = buddy_links(heap, off);
+
+    links->prev = BUDDY_NIL;
+    links->next = heap->free_lists[order];
+    if (links->next != BUDDY_NIL) {
+        buddy_links(heap, links->next)->prev = off;
+    }
+    heap->free_lists[order] = off;
+    heap->free_list_bitmap |= (1ULL << order);
+    *buddy_state(heap, off) = (uint8_t)(order + 1) | BUDDY_FREE;
+    heap->free_bytes += 1ULL << order;
+    heap->free_blocks++;
+}
+
+// Unlinks a free block of the given order from its list
+static void buddy_list_remove(BuddyHeap* heap, uint64_t off, int order) {
+    BuddyLinks* links = buddy_links(heap, off);
+
+    if (links->prev != BUDDY_NIL) {
+        buddy_links(heap, links->prev)->next = links->next;
+    } else {
+        heap->free_lists[order] = links->next;
+    }
+    if (links->next != BUDDY_NIL) {
+        buddy_links(heap, links->next)->prev = links->prev;
+    }
+    if (heap->free_lists[order] == BUDDY_NIL) {
+        heap->free_list_bitmap &= ~(1ULL << order);
+    }
+    *buddy_state(heap, off) = 0;
+    heap->free_bytes -= 1ULL << order;
+    heap->free_blocks--;
+}
+
+// Records a new high-water mark of allocated bytes
+static inline void buddy_note_peak(BuddyHeap* heap) {
+    uint64_t used = heap->size - heap->free_bytes;
+    if (used > heap->peak_used) {
+        heap->peak_used = used;
+    }
+}
+
+static void* buddy_create(void* base, size_t size) {
+    uintptr_t start = ((uintptr_t)base + (1u << BUDDY_MIN_ORDER) - 1) & ~(uintptr_t)((1u << BUDDY_MIN_ORDER) - 1);
+    size_t lead = start - (uintptr_t)base;
+    if (size < lead + (1u << BUDDY_MIN_ORDER)) {
+        return NULL;
+    }
+
+    BuddyHeap* heap = (BuddyHeap*)malloc(sizeof(BuddyHeap));
+    if (!heap) {
+        return NULL;
+    }
+    heap->base = (char*)start;
+    heap->size = (size - lead) & ~(uint64_t)((1u << BUDDY_MIN_ORDER) - 1);
+    heap->state = (uint8_t*)calloc(heap->size >> BUDDY_MIN_ORDER, 1);
+    if (!heap->state) {
+        free(heap);
+        return NULL;
+    }
+    for (int order = 0; order < BUDDY_NUM_ORDERS; order++) {
+        heap->free_lists[order] = BUDDY_NIL;
+    }
+    heap->free_list_bitmap = 0;
+    heap->free_bytes = 0;
+    heap->free_blocks = 0;
+    heap->used_blocks = 0;
+    heap->peak_used = 0;
+
+    // Cover the region with the largest aligned blocks that fit
+    uint64_t off = 0;
+    while (off < heap->size) {
+        int order = 63 - __builtin_clzll(heap->size - off);
+        if (order > BUDDY_MAX_ORDER) {
+            order = BUDDY_MAX_ORDER;
+        }
+        if (off) {
+            int align = __builtin_ctzll(off);
+            if (align < order) {
+                order = align;
+            }
+        }
+        buddy_list_insert(heap, off, order);
+        off += 1ULL << order;
+    }
+
+    return heap;
+}
+
+static void buddy_destroy(void* handle) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+    free(heap->state);
+    free(heap);
+}
+
+// Allocates a block of the given order
+static void* buddy_alloc_order(BuddyHeap* heap, int order) {
+    if (order > BUDDY_MAX_ORDER) {
+        return NULL;
+    }
+
+    // Smallest non-empty order that can hold the request
+    uint64_t candidates = heap->free_list_bitmap & (~0ULL << order);
+    if (!candidates) {
+        return NULL;
+    }
+    int found = __builtin_ctzll(candidates);
+    uint64_t off = heap->free_lists[found];
+    buddy_list_remove(heap, off, found);
+
+    // Split down, keeping the lower half and freeing the upper one
+    while (found > order) {
+        found--;
+        buddy_list_insert(heap, off + (1ULL << found), found);
+    }
+
+    *buddy_state(heap, off) = (uint8_t)(order + 1);
+    heap->used_blocks++;
+    buddy_note_peak(heap);
+    return heap->base + off;
+}
+
+// Returns the order of the smallest block that holds `size` bytes
+static int buddy_order_for(size_t size) {
+    return size <= (1u << BUDDY_MIN_ORDER) ? BUDDY_MIN_ORDER : 64 - __builtin_clzll((unsigned long long)size - 1);
+}
+
+static void* buddy_alloc(void* handle, size_t size) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    if (size > heap->size) {
+        return NULL;
+    }
+    return buddy_alloc_order(heap, buddy_order_for(size));
+}
+
+// A block is aligned to its own size relative to the region start, so any
+// alignment up to that of the region start is had by taking a large enough
+// block. Larger alignments cannot be met.
+static void* buddy_alloc_aligned(void* handle, size_t size, size_t align) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    if ((uintptr_t)heap->base & (align - 1)) {
+        return NULL;
+    }
+    return buddy_alloc(handle, size > align ? size : align);
+}
+
+// Translates a pointer to its block offset and returns the block's state, or 0
+static uint8_t buddy_lookup(BuddyHeap* heap, void* ptr, uint64_t* off) {
+    if ((char*)ptr < heap->base || (char*)ptr >= heap->base + heap->size) {
+        return 0;
+    }
+    *off = (uint64_t)((char*)ptr - heap->base);
+    if (*off & ((1u << BUDDY_MIN_ORDER) - 1)) {
+        return 0;
+    }
+    return *buddy_state(heap, *off);
+}
+
+static int buddy_free(void* handle, void* ptr) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    uint64_t off;
+    uint8_t state = buddy_lookup(heap, ptr, &off);
+    if (!state) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (state & BUDDY_FREE) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+
+    int order = state - 1;
+    *buddy_state(heap, off) = 0;
+    heap->used_blocks--;
+
+    // Merge with the buddy for as long as it is a free block of the same order
+    while (order < BUDDY_MAX_ORDER) {
+        uint64_t buddy = off ^ (1ULL << order);
+        if (buddy + (1ULL << order) > heap->size || *buddy_state(heap, buddy) != ((uint8_t)(order + 1) | BUDDY_FREE)) {
+            break;
+        }
+        buddy_list_remove(heap, buddy, order);
+        off &= ~(1ULL << order);
+        order++;
+    }
+
+    buddy_list_insert(heap, off, order);
+    return MEM_OK;
+}
+
+// Shrinks a block by freeing its upper halves, or grows it by taking over
+// its buddies when the block is the lower half of each pair and they are free
+static int buddy_resize(void* handle, void* ptr, size_t size) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    uint64_t off;
+    uint8_t state = buddy_lookup(heap, ptr, &off);
+    if (!state) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (state & BUDDY_FREE) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    if (size > heap->size) {
+        return MEM_ERR_NO_ROOM;
+    }
+
+    int order = state - 1;
+    int needed = buddy_order_for(size);
+
+    for (int k = order; k < needed; k++) {
+        uint64_t buddy = off + (1ULL << k);
+        if ((off & (1ULL << k)) || buddy + (1ULL << k) > heap->size || *buddy_state(heap, buddy) != ((uint8_t)(k + 1) | BUDDY_FREE)) {
+            return MEM_ERR_NO_ROOM;
+        }
+    }
+    for (int k = order; k < needed; k++) {
+        buddy_list_remove(heap, off + (1ULL << k), k);
+    }
+    // The upper halves given up here cannot merge: their buddy is this block
+    for (int k = order - 1; k >= needed; k--) {
+        buddy_list_insert(heap, off + (1ULL << k), k);
+    }
+
+    *buddy_state(heap, off) = (uint8_t)(needed + 1);
+    buddy_note_peak(heap);
+    return MEM_OK;
+}
+
+static int buddy_block_size(void* handle, void* ptr, size_t* size) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    uint64_t off;
+    uint8_t state = buddy_lookup(heap, ptr, &off);
+    if (!state) {
+        return MEM_ERR_NOT_FOUND;
+    }
+    if (state & BUDDY_FREE) {
+        return MEM_ERR_NOT_ALLOCATED;
+    }
+    *size = (size_t)1 << (state - 1);
+    return MEM_OK;
+}
+
+// Everything after the links of a free block is unused; the slot states live
+// outside the region
+static void buddy_free_runs(void* handle, mem_run_fn fn, void* ctx) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    for (uint64_t orders = heap->free_list_bitmap; orders; orders &= orders - 1) {
+        int order = __builtin_ctzll(orders);
+        for (uint64_t off = heap->free_lists[order]; off != BUDDY_NIL; off = buddy_links(heap, off)->next) {
+            fn(heap->base + off + sizeof(BuddyLinks), (1ULL << order) - sizeof(BuddyLinks), ctx);
+        }
+    }
+}
+
+// Every block start is recorded in the slot states, with its order
+static void buddy_walk(void* handle, mem_block_fn fn, void* ctx) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    uint64_t off = 0;
+    while (off < heap->size) {
+        uint8_t state = *buddy_state(heap, off);
+        if (!state) {
+            // Not a block start, which cannot happen in a consistent heap
+            off += 1u << BUDDY_MIN_ORDER;
+            continue;
+        }
+        uint64_t size = 1ULL << ((state & ~BUDDY_FREE) - 1);
+        fn(heap->base + off, size, (state & BUDDY_FREE) != 0, ctx);
+        off += size;
+    }
+}
+
+static void buddy_stats(void* handle, mem_backend_stats* stats) {
+    BuddyHeap* heap = (BuddyHeap*)handle;
+
+    stats->used_bytes = heap->size - heap->free_bytes;
+    stats->used_blocks = heap->used_blocks;
+    stats->free_bytes = heap->free_bytes;
+    stats->free_blocks = heap->free_blocks;
+    stats->peak_used_bytes = heap->peak_used;
+    stats->largest_free = heap->free_list_bitmap ? 1ULL << (63 - __builtin_clzll(heap->free_list_bitmap)) : 0;
+}
+
+const mem_backend mem_buddy_backend = {
+    .name = "buddy",
+    .create = buddy_create,
+    .destroy = buddy_destroy,
+    .alloc = buddy_alloc,
+    .alloc_aligned = buddy_alloc_aligned,
+    .free = buddy_free,
+    .resize = buddy_resize,
+    .block_size = buddy_block_size,
+    .free_runs = buddy_free_runs,
+    .walk = buddy_walk,
+    .stats = buddy_stats,
+};
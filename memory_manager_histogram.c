@@ -0,0 +1,100 @@
+// memory_manager_histogram.c
+//
+// Reading latency histograms. Pools record into them (see the latency shards
+// in memory_manager.c); the functions here only look at snapshots, so they
+// work as well on histograms merged from several pools or read back from
+// elsewhere.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "memory_manager.h"
+#include "memory_manager_internal.h"
+
+// Returns the highest latency, in ns, that falls into `bucket`
+static uint64_t hist_bucket_max(int bucket) {
+    if (bucket < 8) {
+        return (uint64_t)bucket;
+    }
+    int exp = bucket / 8 + 2;
+    uint64_t lowest = (uint64_t)(8 + bucket % 8) << (exp - 3);
+    return lowest + ((uint64_t)1 << (exp - 3)) - 1;
+}
+
+// Adds up the buckets of one operation over the size classes asked for
+static void hist_collect(const mem_histogram_t* hist, mem_op_t op, int size_class, uint64_t counts[MEM_HIST_BUCKETS]) {
+    int first = size_class < 0 ? 0 : size_class;
+    int last = size_class < 0 ? MEM_HIST_SIZE_CLASSES - 1 : size_class;
+    for (int b = 0; b < MEM_HIST_BUCKETS; b++) {
+        counts[b] = 0;
+    }
+    if (op < 0 || op >= MEM_OPS || last >= MEM_HIST_SIZE_CLASSES) {
+        return;
+    }
+    for (int cls = first; cls <= last; cls++) {
+        for (int b = 0; b < MEM_HIST_BUCKETS; b++) {
+            counts[b] += hist->counts[op][cls][b];
+        }
+    }
+}
+
+void mem_histogram_merge(mem_histogram_t* into, const mem_histogram_t* from) {
+    uint64_t* to = &into->counts[0][0][0];
+    const uint64_t* add = &from->counts[0][0][0];
+    for (size_t i = 0; i < sizeof(into->counts) / sizeof(uint64_t); i++) {
+        to[i] += add[i];
+    }
+}
+
+uint64_t mem_histogram_count(const mem_histogram_t* hist, mem_op_t op, int size_class) {
+    uint64_t counts[MEM_HIST_BUCKETS];
+    hist_collect(hist, op, size_class, counts);
+    uint64_t total = 0;
+    for (int b = 0; b < MEM_HIST_BUCKETS; b++) {
+        total += counts[b];
+    }
+    return total;
+}
+
+uint64_t mem_histogram_percentile(const mem_histogram_t* hist, mem_op_t op, int size_class, double percentile) {
+    uint64_t counts[MEM_HIST_BUCKETS];
+    hist_collect(hist, op, size_class, counts);
+    uint64_t total = 0;
+    for (int b = 0; b < MEM_HIST_BUCKETS; b++) {
+        total += counts[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // The operation of this rank, counting from 1, is the one asked for
+    double exact = percentile / 100.0 * (double)total;
+    uint64_t rank = (uint64_t)exact;
+    if ((double)rank < exact || rank == 0) {
+        rank++;
+    }
+    if (rank > total) {
+        rank = total;
+    }
+
+    uint64_t seen = 0;
+    for (int b = 0; b < MEM_HIST_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return hist_bucket_max(b);
+        }
+    }
+    return hist_bucket_max(MEM_HIST_BUCKETS - 1);
+}
+
+void mem_histogram_print(const mem_histogram_t* hist, FILE* out) {
+    static const char* names[MEM_OPS] = {"alloc", "free", "resize"};
+    fprintf(out, "%-8s %12s %10s %10s %10s %12s\n", "op", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+    for (int op = 0; op < MEM_OPS; op++) {
+        fprintf(out, "%-8s %12llu %10llu %10llu %10llu %12llu\n", names[op],
+                (unsigned long long)mem_histogram_count(hist, op, -1),
+                (unsigned long long)mem_histogram_percentile(hist, op, -1, 50),
+                (unsigned long long)mem_histogram_percentile(hist, op, -1, 99),
+                (unsigned long long)mem_histogram_percentile(hist, op, -1, 99.9),
+                (unsigned long long)mem_histogram_percentile(hist, op, -1, 100));
+    }
+}
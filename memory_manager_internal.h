@@ -0,0 +1,110 @@
+// memory_manager_internal.h
+#ifndef MEMORY_MANAGER_INTERNAL_H
+#define MEMORY_MANAGER_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "memory_manager.h"
+
+// Status codes returned by backend operations
+#define MEM_OK 0
+#define MEM_ERR_NOT_FOUND 1     // Pointer does not belong to the heap
+#define MEM_ERR_NOT_ALLOCATED 2 // Pointer refers to a block that is already free
+#define MEM_ERR_NO_ROOM 3       // The block cannot be resized where it is
+
+// Number of power-of-two size classes used by the segregated free lists
+#define NUM_SIZE_CLASSES 64
+
+// Returns floor(log2(size)), i.e. the size class a free block of this size lives in
+static inline int size_class(size_t size)
+{
+    if (size <= 1)
+        return 0;
+    return 63 - __builtin_clzll((unsigned long long)size);
+}
+
+// Returns the lowest class whose every member is at least `size` bytes
+static inline int size_class_fit(size_t size)
+{
+    int cls = size_class(size);
+    if (size > 1 && (size & (size - 1)) != 0)
+        cls++;
+    return cls;
+}
+
+// Returns the latency histogram bucket of `ns`, see MEM_HIST_BUCKETS
+static inline int hist_bucket(uint64_t ns)
+{
+    if (ns < 8)
+        return (int)ns;
+    int exp = 63 - __builtin_clzll((unsigned long long)ns);
+    int bucket = (exp - 2) * 8 + (int)((ns >> (exp - 3)) & 7);
+    return bucket < MEM_HIST_BUCKETS ? bucket : MEM_HIST_BUCKETS - 1;
+}
+
+// Returns the latency histogram size class of a `size`-byte request
+static inline int hist_size_class(size_t size)
+{
+    if (size <= 16)
+        return 0;
+    int cls = size_class_fit(size) - 4;
+    return cls < MEM_HIST_SIZE_CLASSES ? cls : MEM_HIST_SIZE_CLASSES - 1;
+}
+
+// Occupancy of one backend heap. Backends keep these counters up to date as
+// blocks come and go; only largest_free is looked up when asked for.
+typedef struct mem_backend_stats
+{
+    size_t used_bytes;      // Bytes in allocated blocks, including their headers and padding
+    size_t used_blocks;     // Number of allocated blocks
+    size_t free_bytes;      // Bytes in free blocks
+    size_t free_blocks;     // Number of free blocks
+    size_t largest_free;    // Size of the largest free block
+    size_t peak_used_bytes; // Highest used_bytes so far
+} mem_backend_stats;
+
+// Called with a run of free memory that holds no backend metadata
+typedef void (*mem_run_fn)(void *start, size_t size, void *ctx);
+
+// Called with every block of a heap, headers included, in address order
+typedef void (*mem_block_fn)(void *start, size_t size, int is_free, void *ctx);
+
+/*
+ * An allocation backend manages one contiguous region of memory. The front end
+ * in memory_manager.c owns the region and the lock; backends are only ever
+ * called with that lock held and keep all of their state in the `heap` handle
+ * returned by create().
+ */
+typedef struct mem_backend
+{
+    const char *name;
+    void *(*create)(void *base, size_t size);              // Returns NULL on failure
+    void *(*attach)(void *base, size_t size, int rebuild);  // Takes over a heap create() left in `base`; optional
+    void (*set_placement)(void *heap, mem_placement_t placement); // Chooses how free blocks are picked; optional
+    void (*destroy)(void *heap);
+    void *(*alloc)(void *heap, size_t size);                // Returns NULL when nothing fits
+    void *(*alloc_aligned)(void *heap, size_t size, size_t align); // `align` is a power of two
+    // Carves `count` adjacent blocks of `size` bytes, aligned to `align` (0 or a
+    // power of two), out of one free block; returns how many it stored in
+    // `ptrs`, 0 if no free block holds them all. Optional.
+    size_t (*alloc_run)(void *heap, size_t size, size_t count, size_t align, void **ptrs);
+    int (*free)(void *heap, void *ptr);                     // MEM_OK or MEM_ERR_*
+    int (*resize)(void *heap, void *ptr, size_t size);      // Grows or shrinks in place: MEM_OK or MEM_ERR_*
+    int (*block_size)(void *heap, void *ptr, size_t *size); // Usable size of an allocated block
+    void (*free_runs)(void *heap, mem_run_fn fn, void *ctx); // Reports every free block's metadata-free interior
+    void (*walk)(void *heap, mem_block_fn fn, void *ctx);      // Reports every block, allocated or free
+    void (*stats)(void *heap, mem_backend_stats *stats);
+} mem_backend;
+
+// The pool behind mem_alloc and friends, or NULL outside mem_init_ex/mem_deinit
+mem_pool_t *mem_default_pool(void);
+
+// Grows or shrinks a block of `pool` without ever moving it: MEM_OK or MEM_ERR_*
+int mem_pool_resize_in_place(mem_pool_t *pool, void *block, size_t size);
+
+extern const mem_backend mem_list_backend;
+extern const mem_backend mem_tags_backend;
+extern const mem_backend mem_buddy_backend;
+extern const mem_backend mem_tlsf_backend;
+
+#endif // MEMORY_MANAGER_INTERNAL_H
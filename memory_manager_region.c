@@ -0,0 +1,130 @@
+// memory_manager_region.c
+//
+// Regions for request-scoped allocation. A region takes a chunk from a memory
+// pool and hands out objects by bumping a cursor through it; objects are
+// never freed one by one. When the chunk is used up the region first tries to
+// grow it in place, so that a region is usually a single pool block, and
+// otherwise starts a new chunk at least twice the size of the last one.
+// mem_region_release returns the chunks to the pool, at a cost that does not
+// depend on how many objects were allocated.
+//
+// A region is not thread-safe; every thread should use its own.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "memory_manager.h"
+#include "memory_manager_internal.h"
+
+#define REGION_ALIGN 16         // Alignment of every object
+#define REGION_FIRST_CHUNK 4096 // Size of the first chunk
+
+// Header at the start of every chunk, linking it to the one before
+typedef struct RegionChunk {
+    struct RegionChunk* prev;
+    size_t size; // Size of the chunk, header included
+} RegionChunk;
+
+struct mem_region {
+    mem_pool_t* pool;   // Pool the chunks come from
+    RegionChunk* chunk; // Current chunk, NULL until the first allocation
+    char* cursor;       // First unused byte of the current chunk
+    char* limit;        // End of the current chunk
+};
+
+// Takes `size` bytes off the current chunk, or returns NULL if they do not fit
+static inline void* region_bump(mem_region_t* region, size_t size) {
+    uintptr_t ptr = ((uintptr_t)region->cursor + REGION_ALIGN - 1) & ~(uintptr_t)(REGION_ALIGN - 1);
+    if (ptr > (uintptr_t)region->limit || size > (uintptr_t)region->limit - ptr) {
+        return NULL;
+    }
+    region->cursor = (char*)ptr + size;
+    return (void*)ptr;
+}
+
+// Makes room for `size` more bytes by growing the current chunk or adding one
+static int region_refill(mem_region_t* region, size_t size) {
+    RegionChunk* chunk = region->chunk;
+    if (size > SIZE_MAX / 4) {
+        return -1;
+    }
+
+    if (chunk) {
+        size_t used = (size_t)(region->cursor - (char*)chunk);
+        size_t grown = used + REGION_ALIGN + size;
+        if (grown < 2 * chunk->size) {
+            grown = 2 * chunk->size;
+        }
+        if (mem_pool_resize_in_place(region->pool, chunk, grown) == MEM_OK) {
+            chunk->size = grown;
+            region->limit = (char*)chunk + grown;
+            return 0;
+        }
+    }
+
+    // A new chunk: twice the last one if the pool has room, else just enough
+    size_t needed = sizeof(RegionChunk) + REGION_ALIGN + size;
+    size_t chunk_size = chunk ? 2 * chunk->size : REGION_FIRST_CHUNK;
+    if (chunk_size < needed) {
+        chunk_size = needed;
+    }
+    RegionChunk* fresh = (RegionChunk*)mem_pool_alloc(region->pool, chunk_size);
+    if (!fresh && chunk_size > needed) {
+        chunk_size = needed;
+        fresh = (RegionChunk*)mem_pool_alloc(region->pool, chunk_size);
+    }
+    if (!fresh) {
+        return -1;
+    }
+
+    fresh->prev = chunk;
+    fresh->size = chunk_size;
+    region->chunk = fresh;
+    region->cursor = (char*)(fresh + 1);
+    region->limit = (char*)fresh + chunk_size;
+    return 0;
+}
+
+mem_region_t* mem_region_begin() {
+    if (!mem_default_pool()) {
+        fprintf(stderr, "Warning: mem_region_begin called before mem_init.\n");
+        return NULL;
+    }
+    return mem_pool_region_begin(mem_default_pool());
+}
+
+mem_region_t* mem_pool_region_begin(mem_pool_t* pool) {
+    mem_region_t* region = (mem_region_t*)calloc(1, sizeof(mem_region_t));
+    if (!region) {
+        return NULL;
+    }
+    region->pool = pool;
+    return region;
+}
+
+void* mem_region_alloc(mem_region_t* region, size_t size) {
+    // Zero-byte requests still take one byte so that every object is distinct
+    if (size == 0) {
+        size = 1;
+    }
+
+    void* ptr = region_bump(region, size);
+    if (!ptr && region_refill(region, size) == 0) {
+        ptr = region_bump(region, size);
+    }
+    return ptr;
+}
+
+void mem_region_release(mem_region_t* region) {
+    if (!region) {
+        return;
+    }
+
+    RegionChunk* chunk = region->chunk;
+    while (chunk) {
+        RegionChunk* prev = chunk->prev;
+        mem_pool_free(region->pool, chunk);
+        chunk = prev;
+    }
+    free(region);
+}
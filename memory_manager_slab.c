@@ -0,0 +1,213 @@
+// memory_manager_slab.c
+//
+// Slab allocator for fixed-size objects. Pages are carved out of a memory
+// pool with mem_pool_alloc and split into equally sized objects. Free objects form
+// a lock-free (Treiber) stack threaded through the objects themselves, so
+// mem_slab_alloc and mem_slab_free never take a lock; only growing the slab
+// by another page is serialized.
+//
+// The stack head packs a 44-bit reference (the object address divided by 8,
+// which fits any user-space address; 0 means empty) with a 20-bit tag that
+// is bumped by every push and pop. Addresses rather than pool offsets are
+// used because a growable pool adds chunks anywhere in the address space. A pop that read a
+// stale head therefore fails its compare-and-swap even if the same object has
+// been popped and pushed back in the meantime (the ABA problem).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "memory_manager.h"
+#include "memory_manager_internal.h"
+
+#define SLAB_PAGE_SIZE 4096    // Preferred page size
+#define SLAB_MIN_PAGE_SIZE 64  // Smallest page tried when the pool is nearly full
+#define SLAB_ALIGN 16          // Alignment of the first object in a page
+#define SLAB_REF_BITS 44
+#define SLAB_REF_SHIFT 3       // Objects are at least 8-byte aligned
+#define SLAB_REF_MASK ((1ULL << SLAB_REF_BITS) - 1)
+
+// Header at the start of every page, linking the pages for mem_slab_destroy
+typedef struct SlabPage {
+    struct SlabPage* next;
+} SlabPage;
+
+struct mem_slab {
+    uint64_t free_head;        // Packed tag and reference of the top free object
+    mem_pool_t* pool;          // Pool the pages come from
+    size_t obj_size;           // Object stride, a multiple of 8 and at least 8
+    pthread_mutex_t grow_lock; // Serializes adding pages
+    SlabPage* pages;           // All pages owned by the slab
+};
+
+// Object stride for objects of `obj_size` bytes
+static inline size_t slab_stride(size_t obj_size) {
+    return obj_size < sizeof(uint64_t) ? sizeof(uint64_t) : (obj_size + 7) & ~(size_t)7;
+}
+
+// Smallest page that holds a header and one object of `stride` bytes,
+// whatever the page's alignment
+static inline size_t slab_min_page_size(size_t stride) {
+    size_t size = sizeof(SlabPage) + SLAB_ALIGN + stride;
+    return size < SLAB_MIN_PAGE_SIZE ? SLAB_MIN_PAGE_SIZE : size;
+}
+
+static inline uint64_t slab_ref(void* obj) {
+    return (uint64_t)(uintptr_t)obj >> SLAB_REF_SHIFT;
+}
+
+static inline void* slab_obj(uint64_t ref) {
+    return (void*)(uintptr_t)(ref << SLAB_REF_SHIFT);
+}
+
+// Pushes the chain first..last (already linked through their first word) onto the free stack
+static void slab_push(mem_slab_t* slab, void* first, void* last) {
+    uint64_t head = __atomic_load_n(&slab->free_head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    do {
+        __atomic_store_n((uint64_t*)last, head & SLAB_REF_MASK, __ATOMIC_RELAXED);
+        new_head = ((head >> SLAB_REF_BITS) + 1) << SLAB_REF_BITS | slab_ref(first);
+    } while (!__atomic_compare_exchange_n(&slab->free_head, &head, new_head, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Pops the top free object, or returns NULL if the stack is empty
+static void* slab_pop(mem_slab_t* slab) {
+    uint64_t head = __atomic_load_n(&slab->free_head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint64_t ref = head & SLAB_REF_MASK;
+        if (!ref) {
+            return NULL;
+        }
+        void* obj = slab_obj(ref);
+        // The object may already have been handed out by another thread, in
+        // which case this reads garbage, but the tag makes the CAS below fail
+        uint64_t next = __atomic_load_n((uint64_t*)obj, __ATOMIC_RELAXED) & SLAB_REF_MASK;
+        uint64_t new_head = ((head >> SLAB_REF_BITS) + 1) << SLAB_REF_BITS | next;
+        if (__atomic_compare_exchange_n(&slab->free_head, &head, new_head, 1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            return obj;
+        }
+    }
+}
+
+// Adds a page to the slab. Returns 0 if the slab has free objects afterwards.
+static int slab_grow(mem_slab_t* slab) {
+    pthread_mutex_lock(&slab->grow_lock);
+
+    // Another thread may have grown the slab while we waited for the lock
+    if (__atomic_load_n(&slab->free_head, __ATOMIC_ACQUIRE) & SLAB_REF_MASK) {
+        pthread_mutex_unlock(&slab->grow_lock);
+        return 0;
+    }
+
+    // Take the largest page, down to SLAB_MIN_PAGE_SIZE, that still fits in the pool
+    size_t page_size = SLAB_PAGE_SIZE;
+    size_t min_page_size = slab_min_page_size(slab->obj_size);
+    if (page_size < min_page_size) {
+        page_size = min_page_size;
+    }
+    SlabPage* page = NULL;
+    for (; page_size >= min_page_size; page_size /= 2) {
+        page = (SlabPage*)mem_pool_alloc(slab->pool, page_size);
+        if (page) {
+            break;
+        }
+    }
+
+    char* first = NULL;
+    size_t count = 0;
+    if (page) {
+        uintptr_t start = ((uintptr_t)(page + 1) + SLAB_ALIGN - 1) & ~(uintptr_t)(SLAB_ALIGN - 1);
+        first = (char*)start;
+        count = ((char*)page + page_size - first) / slab->obj_size;
+    }
+    if (count == 0) {
+        if (page) {
+            mem_pool_free(slab->pool, page);
+        }
+        pthread_mutex_unlock(&slab->grow_lock);
+        return -1;
+    }
+
+    page->next = slab->pages;
+    slab->pages = page;
+
+    // Link the new objects into a chain and publish it with a single push
+    for (size_t i = 0; i + 1 < count; i++) {
+        *(uint64_t*)(first + i * slab->obj_size) = slab_ref(first + (i + 1) * slab->obj_size);
+    }
+    slab_push(slab, first, first + (count - 1) * slab->obj_size);
+
+    pthread_mutex_unlock(&slab->grow_lock);
+    return 0;
+}
+
+// Whole pages of the size slab_grow tries first, which a pool of exactly
+// that many pages always has room for. Pages are 16-byte aligned there, so
+// the objects start right after a 16-byte header.
+size_t mem_slab_pool_size(size_t obj_size, size_t count) {
+    size_t stride = slab_stride(obj_size);
+    size_t page_size = slab_min_page_size(stride);
+    if (page_size < SLAB_PAGE_SIZE) {
+        page_size = SLAB_PAGE_SIZE;
+    }
+    page_size = (page_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+
+    size_t per_page = (page_size - SLAB_ALIGN) / stride;
+    size_t pages = count ? (count + per_page - 1) / per_page : 1;
+    return pages * page_size;
+}
+
+mem_slab_t* mem_slab_create(size_t obj_size) {
+    if (!mem_default_pool()) {
+        fprintf(stderr, "Warning: mem_slab_create called before mem_init.\n");
+        return NULL;
+    }
+    return mem_pool_slab_create(mem_default_pool(), obj_size);
+}
+
+mem_slab_t* mem_pool_slab_create(mem_pool_t* pool, size_t obj_size) {
+    mem_slab_t* slab = (mem_slab_t*)calloc(1, sizeof(mem_slab_t));
+    if (!slab) {
+        return NULL;
+    }
+
+    slab->pool = pool;
+    slab->obj_size = slab_stride(obj_size);
+    pthread_mutex_init(&slab->grow_lock, NULL);
+    return slab;
+}
+
+void* mem_slab_alloc(mem_slab_t* slab) {
+    void* obj = slab_pop(slab);
+    while (!obj) {
+        if (slab_grow(slab) != 0) {
+            return NULL;
+        }
+        obj = slab_pop(slab);
+    }
+    return obj;
+}
+
+void mem_slab_free(mem_slab_t* slab, void* obj) {
+    if (!obj) {
+        fprintf(stderr, "Warning: Attempted to free a NULL pointer.\n");
+        return;
+    }
+    slab_push(slab, obj, obj);
+}
+
+void mem_slab_destroy(mem_slab_t* slab) {
+    if (!slab) {
+        return;
+    }
+
+    SlabPage* page = slab->pages;
+    while (page) {
+        SlabPage* next = page->next;
+        mem_pool_free(slab->pool, page);
+        page = next;
+    }
+
+    pthread_mutex_destroy(&slab->grow_lock);
+    free(slab);
+}
@@ -0,0 +1,250 @@
+// memory_manager_tags.c
+//
+// Boundary-tag backend. All metadata lives inside the pool: a TagHeap header
+// at the start of the pool, then the blocks of the boundary-tag layer
+// (memory_manager_blocks.c), whose headers record whether the block before
+// is allocated, so both neighbours are found in O(1) and a freed block is
+// always merged with free blocks on either side. Free blocks are filed in
+// segregated size-class lists threaded through their payloads.
+//
+// Links are stored as byte offsets from the TagHeap rather than pointers so
+// that the layout does not depend on the address the pool is mapped at.
+
+#include <stdint.h>
+#include <string.h>
+#include "memory_manager_internal.h"
+#include "memory_manager_blocks.h"
+
+// Heap header placed at the (aligned) start of the pool
+typedef struct TagHeap {
+    BtArea area;                           // Block offsets are relative to the TagHeap
+    uint64_t free_lists[NUM_SIZE_CLASSES]; // Offsets of the size-class list heads, 0 if empty
+    uint64_t free_list_bitmap;             // Bit k set if free_lists[k] is non-empty
+} TagHeap;
+
+static const BtIndex tag_index;
+
+static inline BtBlocks tag_blocks(TagHeap* heap) {
+    return (BtBlocks){.base = (char*)heap, .area = &heap->area, .index = &tag_index, .heap = heap};
+}
+
+static inline size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+// Adds a free block to the head of its size-class list
+static void tag_list_insert(void* handle, uint64_t off) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+    int cls = size_class(bt_size(&blocks, off));
+    BtLinks* links = bt_links(&blocks, off);
+
+    links->prev = 0;
+    links->next = heap->free_lists[cls];
+    if (links->next) {
+        bt_links(&blocks, links->next)->prev = off;
+    }
+    heap->free_lists[cls] = off;
+    heap->free_list_bitmap |= (1ULL << cls);
+}
+
+// Unlinks a free block from its size-class list
+static void tag_list_remove(void* handle, uint64_t off) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+    int cls = size_class(bt_size(&blocks, off));
+    BtLinks* links = bt_links(&blocks, off);
+
+    if (links->prev) {
+        bt_links(&blocks, links->prev)->next = links->next;
+    } else {
+        heap->free_lists[cls] = links->next;
+    }
+    if (links->next) {
+        bt_links(&blocks, links->next)->prev = links->prev;
+    }
+    if (!heap->free_lists[cls]) {
+        heap->free_list_bitmap &= ~(1ULL << cls);
+    }
+}
+
+static const BtIndex tag_index = {
+    .insert = tag_list_insert,
+    .remove = tag_list_remove,
+};
+
+// Finds a free block of at least `size` bytes (header included), see find_free_block
+static uint64_t tag_find(TagHeap* heap, size_t size) {
+    int cls = size_class(size);
+    int fit_cls = size_class_fit(size);
+
+    uint64_t candidates = fit_cls < NUM_SIZE_CLASSES ? heap->free_list_bitmap & (~0ULL << fit_cls) : 0;
+    if (candidates) {
+        return heap->free_lists[__builtin_ctzll(candidates)];
+    }
+
+    if (fit_cls != cls) {
+        BtBlocks blocks = tag_blocks(heap);
+        for (uint64_t off = heap->free_lists[cls]; off != 0; off = bt_links(&blocks, off)->next) {
+            if (bt_size(&blocks, off) >= size) {
+                return off;
+            }
+        }
+    }
+    return 0;
+}
+
+// Offset of the first block header from the TagHeap. Block headers sit 8
+// bytes before a 16-byte boundary so payloads are aligned.
+#define TAG_FIRST (align_up(sizeof(TagHeap), BT_ALIGN) + BT_HEADER_SIZE)
+
+static void* tags_create(void* base, size_t size) {
+    size_t lead = align_up((uintptr_t)base, BT_ALIGN) - (uintptr_t)base;
+
+    if (size < lead + TAG_FIRST + BT_MIN_SPAN) {
+        return NULL;
+    }
+
+    TagHeap* heap = (TagHeap*)((char*)base + lead);
+    memset(heap, 0, sizeof(TagHeap));
+    BtBlocks blocks = tag_blocks(heap);
+    bt_init(&blocks, TAG_FIRST, size - lead);
+
+    return heap;
+}
+
+// Takes over the heap tags_create left in this memory, e.g. in a file mapped
+// again. Everything is held as offsets, so the memory may be at another
+// address now. With `rebuild` the heap may have been abandoned halfway
+// through an operation: the flags, footers, free lists and counters are then
+// rebuilt from the block sizes, merging free neighbours.
+static void* tags_attach(void* base, size_t size, int rebuild) {
+    size_t lead = align_up((uintptr_t)base, BT_ALIGN) - (uintptr_t)base;
+
+    if (size < lead + TAG_FIRST + BT_MIN_SPAN) {
+        return NULL;
+    }
+    TagHeap* heap = (TagHeap*)((char*)base + lead);
+    size_t avail = (size - lead - TAG_FIRST - BT_HEADER_SIZE) & ~BT_FLAGS;
+    if (heap->area.first != TAG_FIRST || heap->area.end != TAG_FIRST + avail) {
+        return NULL;
+    }
+    if (!rebuild) {
+        return heap;
+    }
+
+    memset(heap->free_lists, 0, sizeof(heap->free_lists));
+    heap->free_list_bitmap = 0;
+    BtBlocks blocks = tag_blocks(heap);
+    return bt_rebuild(&blocks) == 0 ? heap : NULL;
+}
+
+static void tags_destroy(void* heap) {
+    (void)heap; // Everything lives in the pool itself
+}
+
+static void* tags_alloc(void* handle, size_t size) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+
+    size_t asize = bt_request_size(&blocks, size);
+    uint64_t off = asize ? tag_find(heap, asize) : 0;
+    return off ? bt_take(&blocks, off, asize) : NULL;
+}
+
+// Payloads are always BT_ALIGN-aligned. For larger alignments a block with
+// room for the padding is taken, see bt_take_aligned.
+static void* tags_alloc_aligned(void* handle, size_t size, size_t align) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+
+    if (align <= BT_ALIGN) {
+        return tags_alloc(handle, size);
+    }
+    size_t asize = bt_request_size(&blocks, size);
+    if (!asize || align > heap->area.end) {
+        return NULL;
+    }
+    uint64_t off = tag_find(heap, asize + align + BT_MIN_BLOCK);
+    return off ? bt_take_aligned(&blocks, off, asize, align) : NULL;
+}
+
+// A run of blocks is carved from one free block that holds all of them
+static size_t tags_alloc_run(void* handle, size_t size, size_t count, size_t align, void** ptrs) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+
+    size_t asize = bt_request_size(&blocks, size);
+    if (align > BT_ALIGN || !asize || count == 0 || asize > heap->area.end / count) {
+        return 0;
+    }
+    uint64_t off = tag_find(heap, asize * count);
+    if (!off) {
+        return 0;
+    }
+    bt_take_run(&blocks, off, asize, count, ptrs);
+    return count;
+}
+
+static int tags_free(void* handle, void* ptr) {
+    BtBlocks blocks = tag_blocks((TagHeap*)handle);
+    return bt_free(&blocks, ptr);
+}
+
+static int tags_resize(void* handle, void* ptr, size_t size) {
+    BtBlocks blocks = tag_blocks((TagHeap*)handle);
+    return bt_resize(&blocks, ptr, size);
+}
+
+static int tags_block_size(void* handle, void* ptr, size_t* size) {
+    BtBlocks blocks = tag_blocks((TagHeap*)handle);
+    return bt_block_size(&blocks, ptr, size);
+}
+
+static void tags_free_runs(void* handle, mem_run_fn fn, void* ctx) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+
+    for (uint64_t classes = heap->free_list_bitmap; classes; classes &= classes - 1) {
+        for (uint64_t off = heap->free_lists[__builtin_ctzll(classes)]; off != 0; off = bt_links(&blocks, off)->next) {
+            bt_free_run(&blocks, off, fn, ctx);
+        }
+    }
+}
+
+static void tags_walk(void* handle, mem_block_fn fn, void* ctx) {
+    BtBlocks blocks = tag_blocks((TagHeap*)handle);
+    bt_walk(&blocks, fn, ctx);
+}
+
+static void tags_stats(void* handle, mem_backend_stats* stats) {
+    TagHeap* heap = (TagHeap*)handle;
+    BtBlocks blocks = tag_blocks(heap);
+    bt_stats(&blocks, stats);
+
+    // The largest free block is in the highest non-empty class
+    if (heap->free_list_bitmap) {
+        int cls = 63 - __builtin_clzll(heap->free_list_bitmap);
+        for (uint64_t off = heap->free_lists[cls]; off != 0; off = bt_links(&blocks, off)->next) {
+            if (bt_size(&blocks, off) > stats->largest_free) {
+                stats->largest_free = bt_size(&blocks, off);
+            }
+        }
+    }
+}
+
+const mem_backend mem_tags_backend = {
+    .name = "tags",
+    .create = tags_create,
+    .attach = tags_attach,
+    .destroy = tags_destroy,
+    .alloc = tags_alloc,
+    .alloc_aligned = tags_alloc_aligned,
+    .alloc_run = tags_alloc_run,
+    .free = tags_free,
+    .resize = tags_resize,
+    .block_size = tags_block_size,
+    .free_runs = tags_free_runs,
+    .walk = tags_walk,
+    .stats = tags_stats,
+};
@@ -0,0 +1,268 @@
+// memory_manager_tlsf.c
+//
+// Two-level segregated fit (TLSF) backend. Free blocks are kept in a matrix
+// of lists: the first level splits sizes by power of two, the second level
+// splits each power-of-two range into TLSF_SL_COUNT equal slices. A bitmap per
+// level records which lists are non-empty, so a suitable list is found with
+// two find-first-set operations.
+//
+// Allocation rounds the request up to the start of the next slice before
+// searching ("good fit"), which guarantees that the head of any list found is
+// large enough: no list is ever walked, and alloc and free run in constant
+// time regardless of how many blocks exist. The price is that a block whose
+// size lies in the same slice as the request, but above it, is not used when
+// no larger list has a block.
+//
+// The blocks themselves are those of the boundary-tag layer
+// (memory_manager_blocks.c), as in the tags backend, so both neighbours are
+// merged on free in O(1); this file only adds the two-level index over them.
+// The list heads and bitmaps live outside the pool.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "memory_manager_internal.h"
+#include "memory_manager_blocks.h"
+
+#define TLSF_ALIGN_LOG2 4                              // log2(BT_ALIGN)
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1u << TLSF_SL_LOG2)             // Second-level slices per power of two
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK (1u << TLSF_FL_SHIFT)         // Sizes below this all map to first level 0
+#define TLSF_FL_COUNT (64 - TLSF_FL_SHIFT + 1)
+
+typedef struct TlsfHeap {
+    char* base;                                       // Block offsets are relative to this address
+    BtArea area;
+    uint64_t fl_bitmap;                               // Bit f set if any list of first level f is non-empty
+    uint32_t sl_bitmap[TLSF_FL_COUNT];                // Bit s set if free_lists[f][s] is non-empty
+    uint64_t free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT]; // Offsets of the list heads, 0 if empty
+} TlsfHeap;
+
+static const BtIndex tlsf_index;
+
+static inline BtBlocks tlsf_blocks(TlsfHeap* heap) {
+    return (BtBlocks){.base = heap->base, .area = &heap->area, .index = &tlsf_index, .heap = heap};
+}
+
+// Maps a block size to the list it is filed under
+static inline void tlsf_mapping_insert(size_t size, int* fl, int* sl) {
+    if (size < TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size >> TLSF_ALIGN_LOG2);
+    } else {
+        int log2 = size_class(size);
+        *fl = log2 - TLSF_FL_SHIFT + 1;
+        *sl = (int)((size >> (log2 - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT);
+    }
+}
+
+// Maps a request to the first list whose every block is at least `size` bytes
+static inline void tlsf_mapping_search(size_t size, int* fl, int* sl) {
+    if (size >= TLSF_SMALL_BLOCK) {
+        size += ((size_t)1 << (size_class(size) - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping_insert(size, fl, sl);
+}
+
+// Adds a free block to the head of its list
+static void tlsf_list_insert(void* handle, uint64_t off) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+    int fl, sl;
+    tlsf_mapping_insert(bt_size(&blocks, off), &fl, &sl);
+    BtLinks* links = bt_links(&blocks, off);
+
+    links->prev = 0;
+    links->next = heap->free_lists[fl][sl];
+    if (links->next) {
+        bt_links(&blocks, links->next)->prev = off;
+    }
+    heap->free_lists[fl][sl] = off;
+    heap->fl_bitmap |= (1ULL << fl);
+    heap->sl_bitmap[fl] |= (1u << sl);
+}
+
+// Unlinks a free block from its list
+static void tlsf_list_remove(void* handle, uint64_t off) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+    int fl, sl;
+    tlsf_mapping_insert(bt_size(&blocks, off), &fl, &sl);
+    BtLinks* links = bt_links(&blocks, off);
+
+    if (links->prev) {
+        bt_links(&blocks, links->prev)->next = links->next;
+    } else {
+        heap->free_lists[fl][sl] = links->next;
+    }
+    if (links->next) {
+        bt_links(&blocks, links->next)->prev = links->prev;
+    }
+    if (!heap->free_lists[fl][sl]) {
+        heap->sl_bitmap[fl] &= ~(1u << sl);
+        if (!heap->sl_bitmap[fl]) {
+            heap->fl_bitmap &= ~(1ULL << fl);
+        }
+    }
+}
+
+static const BtIndex tlsf_index = {
+    .insert = tlsf_list_insert,
+    .remove = tlsf_list_remove,
+};
+
+// Finds a free block of at least `size` bytes (header included) in constant time
+static uint64_t tlsf_find(TlsfHeap* heap, size_t size) {
+    int fl, sl;
+    tlsf_mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return 0;
+    }
+
+    // A larger slice of the same power of two, else the smallest larger power of two
+    uint32_t sl_map = sl < (int)TLSF_SL_COUNT ? heap->sl_bitmap[fl] & (~0u << sl) : 0;
+    if (!sl_map) {
+        uint64_t fl_map = fl + 1 < 64 ? heap->fl_bitmap & (~0ULL << (fl + 1)) : 0;
+        if (!fl_map) {
+            return 0;
+        }
+        fl = __builtin_ctzll(fl_map);
+        sl_map = heap->sl_bitmap[fl];
+    }
+    return heap->free_lists[fl][__builtin_ctz(sl_map)];
+}
+
+static void* tlsf_create(void* base, size_t size) {
+    uintptr_t start = ((uintptr_t)base + BT_ALIGN - 1) & ~(uintptr_t)(BT_ALIGN - 1);
+    size_t lead = start - (uintptr_t)base;
+    // Block headers sit 8 bytes before a 16-byte boundary so payloads are aligned
+    uint64_t first = BT_ALIGN - BT_HEADER_SIZE;
+
+    if (size < lead + first + BT_MIN_SPAN) {
+        return NULL;
+    }
+
+    TlsfHeap* heap = (TlsfHeap*)calloc(1, sizeof(TlsfHeap));
+    if (!heap) {
+        return NULL;
+    }
+
+    heap->base = (char*)start;
+    BtBlocks blocks = tlsf_blocks(heap);
+    bt_init(&blocks, first, size - lead);
+
+    return heap;
+}
+
+static void tlsf_destroy(void* heap) {
+    free(heap);
+}
+
+static void* tlsf_alloc(void* handle, size_t size) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+
+    size_t asize = bt_request_size(&blocks, size);
+    uint64_t off = asize ? tlsf_find(heap, asize) : 0;
+    return off ? bt_take(&blocks, off, asize) : NULL;
+}
+
+// Payloads are always BT_ALIGN-aligned. For larger alignments a block with
+// room for the padding is taken, see bt_take_aligned.
+static void* tlsf_alloc_aligned(void* handle, size_t size, size_t align) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+
+    if (align <= BT_ALIGN) {
+        return tlsf_alloc(handle, size);
+    }
+    size_t asize = bt_request_size(&blocks, size);
+    if (!asize || align > heap->area.end) {
+        return NULL;
+    }
+    uint64_t off = tlsf_find(heap, asize + align + BT_MIN_BLOCK);
+    return off ? bt_take_aligned(&blocks, off, asize, align) : NULL;
+}
+
+// A run of blocks is carved from one free block that holds all of them
+static size_t tlsf_alloc_run(void* handle, size_t size, size_t count, size_t align, void** ptrs) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+
+    size_t asize = bt_request_size(&blocks, size);
+    if (align > BT_ALIGN || !asize || count == 0 || asize > heap->area.end / count) {
+        return 0;
+    }
+    uint64_t off = tlsf_find(heap, asize * count);
+    if (!off) {
+        return 0;
+    }
+    bt_take_run(&blocks, off, asize, count, ptrs);
+    return count;
+}
+
+static int tlsf_free(void* handle, void* ptr) {
+    BtBlocks blocks = tlsf_blocks((TlsfHeap*)handle);
+    return bt_free(&blocks, ptr);
+}
+
+static int tlsf_resize(void* handle, void* ptr, size_t size) {
+    BtBlocks blocks = tlsf_blocks((TlsfHeap*)handle);
+    return bt_resize(&blocks, ptr, size);
+}
+
+static int tlsf_block_size(void* handle, void* ptr, size_t* size) {
+    BtBlocks blocks = tlsf_blocks((TlsfHeap*)handle);
+    return bt_block_size(&blocks, ptr, size);
+}
+
+static void tlsf_free_runs(void* handle, mem_run_fn fn, void* ctx) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+
+    for (uint64_t fls = heap->fl_bitmap; fls; fls &= fls - 1) {
+        int fl = __builtin_ctzll(fls);
+        for (uint32_t sls = heap->sl_bitmap[fl]; sls; sls &= sls - 1) {
+            for (uint64_t off = heap->free_lists[fl][__builtin_ctz(sls)]; off != 0; off = bt_links(&blocks, off)->next) {
+                bt_free_run(&blocks, off, fn, ctx);
+            }
+        }
+    }
+}
+
+static void tlsf_walk(void* handle, mem_block_fn fn, void* ctx) {
+    BtBlocks blocks = tlsf_blocks((TlsfHeap*)handle);
+    bt_walk(&blocks, fn, ctx);
+}
+
+static void tlsf_stats(void* handle, mem_backend_stats* stats) {
+    TlsfHeap* heap = (TlsfHeap*)handle;
+    BtBlocks blocks = tlsf_blocks(heap);
+    bt_stats(&blocks, stats);
+
+    // The largest free block is in the highest non-empty list
+    if (heap->fl_bitmap) {
+        int fl = 63 - __builtin_clzll(heap->fl_bitmap);
+        int sl = 31 - __builtin_clz(heap->sl_bitmap[fl]);
+        for (uint64_t off = heap->free_lists[fl][sl]; off != 0; off = bt_links(&blocks, off)->next) {
+            if (bt_size(&blocks, off) > stats->largest_free) {
+                stats->largest_free = bt_size(&blocks, off);
+            }
+        }
+    }
+}
+
+const mem_backend mem_tlsf_backend = {
+    .name = "tlsf",
+    .create = tlsf_create,
+    .destroy = tlsf_destroy,
+    .alloc = tlsf_alloc,
+    .alloc_aligned = tlsf_alloc_aligned,
+    .alloc_run = tlsf_alloc_run,
+    .free = tlsf_free,
+    .resize = tlsf_resize,
+    .block_size = tlsf_block_size,
+    .free_runs = tlsf_free_runs,
+    .walk = tlsf_walk,
+    .stats = tlsf_stats,
+};
@@ -644,6 +644,25 @@ void test_list_edge_cases()
     printf_green("[PASS].\n");
 }
 
+// A list sized for n nodes must hold all n of them, although its pool is cut
+// into slab pages with headers, down to a list sized for a single node
+void test_list_capacity()
+{
+    printf_yellow("  Testing list capacity ---> ");
+    int counts[] = {1, 2, 255, 256, 1000};
+    for (int c = 0; c < 5; c++)
+    {
+        Node *head = NULL;
+        list_init(&head, sizeof(Node) * counts[c]);
+        for (int i = 0; i < counts[c]; i++)
+            list_insert(&head, i);
+        my_assert(head != NULL && head->data == 0);
+        my_assert(list_count_nodes(&head) == counts[c]);
+        list_cleanup(&head);
+    }
+    printf_green("[PASS].\n");
+}
+
 // Main function to run all tests
 int main(int argc, char *argv[])
 {
@@ -670,6 +689,7 @@ int main(int argc, char *argv[])
         printf(" 6. test_list_insert_after - Test multiple insertions after a given node\n");
         printf(" 7. test_list_insert_after - Test multiple insertions after a given node\n");
         printf(" 8. test_list_delete - Test multiple detelions\n");
+        printf(" 9. test_list_capacity - Test lists sized for exactly their nodes\n");
         printf(" 0. Run all tests\n");
         return 1;
     }
@@ -685,6 +705,7 @@ int main(int argc, char *argv[])
         test_list_insert_after_multithread(&(TestParams){.num_threads = base_num_threads, .num_nodes = 1024});
         test_list_insert_before_multithreaded(&(TestParams){.num_threads = base_num_threads, .num_nodes = 1024});
         test_list_delete_multithreaded(&(TestParams){.num_threads = base_num_threads, .num_nodes = 1024});
+        test_list_capacity();
 
         printf("\nStress testing basic operations with various numbers of threads and nodes:\n");
         for (int i = 0; i < 9; i++)      // from 2^0 = 1 up to 2^8 = 256 threads
@@ -729,6 +750,9 @@ int main(int argc, char *argv[])
             for (int j = 8; j < 14; j++) // from 2^8 = 256 up to 2^14 = 16384 nodes
                 test_list_delete_multithreaded(&(TestParams){.num_threads = pow(2, i), .num_nodes = pow(2, j)});
         break;
+    case 9:
+        test_list_capacity();
+        break;
 
     default:
         printf("Invalid test function\n");
@@ -2,6 +2,7 @@
 #include <sys/time.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "memory_manager.h"
 #include <stdio.h>
 #include <assert.h>
@@ -14,6 +15,8 @@
 #include "common_defs.h"
 
 #include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 #define debug 0
 
@@ -42,6 +45,10 @@ typedef struct
     int num_blocks;
     size_t block_size;
     bool simulate_work;
+    mem_backend_t backend; // Allocation backend to initialize the pool with
+    size_t tcache_count;   // Per-thread cache size, 0 to run without thread caches
+    size_t arenas;         // Number of arenas to split the pool into, 0 for a single one
+    mem_placement_t placement; // Placement policy of the list backend
 } TestParams;
 
 // Function to calculate memory allocations for threads based on redistribution logic
@@ -150,7 +157,7 @@ void testAcrossConfigurations(void (*test_func)(TestParams), TestParams params)
 void run_concurrent_test(void *(*test_func)(void *), TestParams params, char *function_name)
 {
     printf_yellow("  Testing \"%s\" (threads: %d, mem_size: %zu) ---> ", function_name, params.num_threads, params.memory_size);
-    mem_init(params.memory_size);
+    mem_init_ex(&(mem_config_t){.size = params.memory_size, .backend = params.backend, .tcache_count = params.tcache_count, .arenas = params.arenas, .placement = params.placement});
     pthread_t threads[params.num_threads];
     my_barrier_init(&barrier, params.num_threads);
     thread_data_t params_t[params.num_threads];
@@ -233,6 +240,34 @@ void *test_zero_alloc_and_free(void *arg)
     return NULL;
 }
 
+/*
+ * Zero-byte allocations must still return distinct pointers, otherwise freeing
+ * one of them could release a neighbouring block instead.
+ */
+void test_zero_alloc_distinct()
+{
+    printf_yellow("  Testing \"zero alloc returns distinct pointers\" ---> ");
+    mem_init(1024);
+
+    void *block1 = mem_alloc(0);
+    void *block2 = mem_alloc(0);
+    void *block3 = mem_alloc(16);
+    my_assert(block1 != NULL && block2 != NULL && block3 != NULL);
+    my_assert(block1 != block2 && block2 != block3 && block1 != block3);
+
+    mem_free(block3);
+    mem_free(block2);
+    mem_free(block1);
+
+    // Everything was released and merged, so the whole pool is available again
+    void *all = mem_alloc(1024);
+    my_assert(all != NULL);
+    mem_free(all);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
 /*
  * This function is used to test the allocation of random blocks of memory and then freeing them in a multithreading context.
  * The test passes if all allocations and deallocations are successful.
@@ -268,7 +303,7 @@ void test_random_blocks_multithread(TestParams params)
     int total_blocks = 1000 + rand() % 10000;
     int mem_size = total_blocks * params.block_size;
 
-    mem_init(mem_size);
+    mem_init_ex(&(mem_config_t){.size = mem_size, .backend = params.backend, .tcache_count = params.tcache_count, .arenas = params.arenas, .placement = params.placement});
 
     pthread_t threads[params.num_threads];
     thread_data_t thread_data[params.num_threads];
@@ -767,6 +802,11 @@ void test_memory_fragmentation_multithread(TestParams params)
         pthread_join(threads[i], NULL);
     }
 
+    // Every block has been freed, whatever the order: the pool must be whole again
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(stats.blocks_in_use == 0 && stats.free_blocks == 1 && stats.largest_free_block == params.memory_size);
+
     mem_deinit(); // Clean up the memory manager
     my_barrier_destroy(&barrier);
     printf_green("[PASS].\n");
@@ -820,7 +860,7 @@ void run_concurrency_test(TestParams params)
     thread_data_t params_t[params.num_threads];
     my_barrier_init(&barrier, params.num_threads);
     // Initialize your memory manager here
-    mem_init(params.num_blocks * params.block_size); // Initialize with enough memory for the test
+    mem_init_ex(&(mem_config_t){.size = params.num_blocks * params.block_size, .tcache_count = params.tcache_count, .arenas = params.arenas}); // Initialize with enough memory for the test
 
     // Create multiple threads to perform memory operations
     for (int i = 0; i < params.num_threads; i++)
@@ -851,6 +891,1411 @@ void run_concurrency_test(TestParams params)
     printf_green("[PASS].\n");
 }
 
+/*
+ * Allocates a set of differently sized blocks, frees them in an interleaved order
+ * so that blocks are merged with both their predecessor and successor, and then
+ * checks that the pool has been coalesced back into one large free block.
+ */
+void test_backend_coalescing(mem_backend_t backend, char *backend_name)
+{
+    printf_yellow("  Testing \"%s backend coalescing\" ---> ", backend_name);
+
+    size_t pool_size = 64 * 1024;
+    mem_init_ex(&(mem_config_t){.size = pool_size, .backend = backend});
+    mem_stats_t initial, stats;
+    mem_stats(&initial);
+
+    char *blocks[64];
+    for (int i = 0; i < 64; i++)
+    {
+        blocks[i] = mem_alloc(100 + i * 7);
+        my_assert(blocks[i] != NULL);
+        memset(blocks[i], i, 100 + i * 7);
+    }
+
+    for (int i = 0; i < 64; i++)
+        sanityCheck(100 + i * 7, blocks[i], i);
+
+    // Free every other block first, then the ones in between, so that each
+    // of the later frees has to merge with free neighbours on both sides
+    for (int i = 0; i < 64; i += 2)
+        mem_free(blocks[i]);
+    for (int i = 1; i < 64; i += 2)
+        mem_free(blocks[i]);
+    mem_stats(&stats);
+    my_assert(stats.free_blocks == initial.free_blocks && stats.largest_free_block == initial.largest_free_block);
+
+    void *large = mem_alloc(pool_size / 2);
+    my_assert(large != NULL);
+    mem_free(large);
+
+    // Ascending order: every block merges with the free run below it
+    for (int i = 0; i < 64; i++)
+        blocks[i] = mem_alloc(100 + i * 7);
+    for (int i = 0; i < 64; i++)
+        mem_free(blocks[i]);
+    mem_stats(&stats);
+    my_assert(stats.free_blocks == initial.free_blocks && stats.largest_free_block == initial.largest_free_block);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Frees two holes of 300 and 200 bytes in a full pool and checks which of
+ * them each placement policy hands out for three 150-byte requests. The
+ * blocks are packed without alignment so that the sizes come out exact.
+ */
+void test_placement_policy(mem_placement_t placement, char *policy_name)
+{
+    printf_yellow("  Testing \"%s placement\" ---> ", policy_name);
+    mem_init_ex(&(mem_config_t){.size = 1000, .placement = placement, .alignment = 1});
+
+    size_t sizes[5] = {100, 300, 100, 200, 300};
+    char *blocks[5];
+    for (int i = 0; i < 5; i++)
+    {
+        blocks[i] = mem_alloc(sizes[i]);
+        my_assert(blocks[i] != NULL);
+    }
+    my_assert(mem_alloc(1) == NULL);
+    mem_free(blocks[1]);
+    mem_free(blocks[3]);
+
+    char *first = mem_alloc(150);
+    char *second = mem_alloc(150);
+    char *third = mem_alloc(150);
+    switch (placement)
+    {
+    case MEM_PLACE_CLASS_FIT: // The 300-byte hole is the only one certain to fit
+        my_assert(first == blocks[1]);
+        break;
+    case MEM_PLACE_FIRST_FIT: // Lowest address first, both times from the start
+        my_assert(first == blocks[1] && second == blocks[1] + 150 && third == blocks[3]);
+        break;
+    case MEM_PLACE_NEXT_FIT: // From the start, then on from where the last search ended
+        my_assert(first == blocks[1] && second == blocks[1] + 150 && third == blocks[3]);
+        break;
+    case MEM_PLACE_BEST_FIT: // The 200-byte hole first, then the 300-byte one
+        my_assert(first == blocks[3] && second == blocks[1] && third == blocks[1] + 150);
+        break;
+    }
+    my_assert(first && second && third && mem_alloc(51) == NULL);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+typedef struct
+{
+    size_t size;  // Request to find the best fit for
+    char *best;   // Smallest free block of at least `size` bytes, lowest address first
+    size_t found; // Its size
+} best_fit_search_t;
+
+static void find_best_block(const mem_block_info_t *block, void *ctx)
+{
+    best_fit_search_t *search = ctx;
+    if (block->is_free && block->size >= search->size &&
+        (!search->best || block->size < search->found || (block->size == search->found && (char *)block->address < search->best)))
+    {
+        search->best = block->address;
+        search->found = block->size;
+    }
+}
+
+static void find_largest_block(const mem_block_info_t *block, void *ctx)
+{
+    size_t *largest = ctx;
+    if (block->is_free && block->size > *largest)
+        *largest = block->size;
+}
+
+/*
+ * Leaves a few hundred holes of random sizes between allocated blocks and
+ * checks that every best-fit allocation takes the block a full search over
+ * mem_walk would have picked, and that mem_stats finds the largest one.
+ */
+void test_best_fit_tree()
+{
+    printf_yellow("  Testing \"best fit against an exhaustive search\" ---> ");
+    mem_init_ex(&(mem_config_t){.size = 1 << 20, .placement = MEM_PLACE_BEST_FIT});
+
+    unsigned int seed = 42;
+    char *blocks[1024];
+    for (int i = 0; i < 1024; i++)
+    {
+        blocks[i] = mem_alloc(1 + rand_r(&seed) % 600);
+        my_assert(blocks[i] != NULL);
+    }
+    for (int i = 0; i < 1024; i += 2)
+        mem_free(blocks[i]);
+
+    for (int i = 0; i < 400; i++)
+    {
+        best_fit_search_t search = {.size = 1 + rand_r(&seed) % 700};
+        my_assert(mem_walk(find_best_block, &search) == 0);
+        char *block = mem_alloc(search.size);
+        my_assert(block == search.best);
+        if (i % 3 == 0)
+            mem_free(block);
+    }
+
+    size_t largest = 0;
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(mem_walk(find_largest_block, &largest) == 0 && stats.largest_free_block == largest);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Frees a block that has been merged into the free block before it a second
+ * time, and frees and resizes pointers into the middle of a live block. The
+ * backend has to reject all of them: no block may be counted twice, and
+ * memory handed out afterwards must not overlap the block that is still live.
+ */
+void test_invalid_free(mem_backend_t backend, char *backend_name)
+{
+    printf_yellow("  Testing \"%s backend rejects repeated and interior frees\" ---> ", backend_name);
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .backend = backend});
+
+    char *a = mem_alloc(100);
+    char *b = mem_alloc(100);
+    char *c = mem_alloc(100);
+    my_assert(a && b && c);
+    memset(c, 0x5c, 100);
+
+    mem_free(a);
+    mem_free(b); // Merges with a
+    mem_free(b);
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(stats.blocks_in_use == 1);
+
+    // Pointers into the middle of c, one of them behind what an in-pool
+    // header of an allocated 32-byte block would look like
+    memset(c, 0, 100);
+    *(size_t *)(c + 8) = 32 | 1;
+    mem_free(c + 16);
+    mem_free(c + 32);
+    my_assert(mem_resize(c + 16, 48) == NULL);
+    mem_stats(&stats);
+    my_assert(stats.blocks_in_use == 1);
+    memset(c, 0x5c, 100);
+
+    // Fill the pool; none of it may land on c
+    void *filler[1024];
+    int count = 0;
+    while (count < 1024 && (filler[count] = mem_alloc(64)) != NULL)
+        memset(filler[count++], 0xa5, 64);
+    for (int i = 0; i < 100; i++)
+        my_assert((unsigned char)c[i] == 0x5c);
+    for (int i = 0; i < count; i++)
+        mem_free(filler[i]);
+
+    mem_free(c);
+    mem_stats(&stats);
+    my_assert(stats.blocks_in_use == 0 && stats.free_blocks == 1);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Threads repeatedly allocate and free small blocks through their thread caches.
+ * Once the threads have exited their caches must have been flushed, so the main
+ * thread can allocate (almost) the whole pool again.
+ */
+void *thread_cached_alloc_free(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+    char *blocks[16];
+
+    for (int i = 0; i < data->iterations; i++)
+    {
+        for (int j = 0; j < 16; j++)
+        {
+            blocks[j] = mem_alloc(16 + j * 8);
+            my_assert(blocks[j] != NULL);
+            if (blocks[j])
+                memset(blocks[j], data->thread_id, 16 + j * 8);
+        }
+        for (int j = 0; j < 16; j++)
+        {
+            sanityCheck(16 + j * 8, blocks[j], data->thread_id);
+            mem_free(blocks[j]);
+        }
+    }
+    return NULL;
+}
+
+void test_thread_cache_multithread(TestParams params)
+{
+    printf_yellow("  Testing \"thread caches\" (threads: %d, tcache_count: %zu) ---> ", params.num_threads, params.tcache_count);
+
+    size_t pool_size = 64 * 1024 * params.num_threads;
+    mem_init_ex(&(mem_config_t){.size = pool_size, .backend = params.backend, .tcache_count = params.tcache_count, .arenas = params.arenas});
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].thread_id = i;
+        params_t[i].iterations = params.iterations;
+        pthread_create(&threads[i], NULL, thread_cached_alloc_free, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    // The main thread gets a cache of its own
+    void *block = mem_alloc(32);
+    my_assert(block != NULL);
+    mem_free(block);
+
+    // A single block can never span arenas
+    void *large = mem_alloc(pool_size / 2 / (params.arenas ? params.arenas : 1));
+    my_assert(large != NULL);
+    mem_free(large);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Blocks allocated by one thread are freed by another. Each block must go back
+ * to the arena it was carved from, which is checked by filling every arena
+ * completely once all blocks have been released.
+ */
+void *thread_free_blocks(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+    for (int i = 0; i < data->num_blocks; i++)
+        mem_free(data->block_pointers[i]);
+    return NULL;
+}
+
+void test_arena_cross_thread_free(size_t num_arenas)
+{
+    printf_yellow("  Testing \"free into the owning arena\" (arenas: %zu) ---> ", num_arenas);
+
+    size_t arena_size = 1024;
+    mem_init_ex(&(mem_config_t){.size = arena_size * num_arenas, .arenas = num_arenas});
+
+    // The main thread spills over from its home arena into all the others
+    int num_blocks = (int)num_arenas;
+    void *blocks[num_blocks];
+    for (int i = 0; i < num_blocks; i++)
+    {
+        blocks[i] = mem_alloc(arena_size);
+        my_assert(blocks[i] != NULL);
+    }
+    my_assert(mem_alloc(1) == NULL);
+
+    pthread_t thread;
+    thread_data_t data = {.num_blocks = num_blocks, .block_pointers = blocks};
+    pthread_create(&thread, NULL, thread_free_blocks, &data);
+    pthread_join(thread, NULL);
+
+    for (size_t i = 0; i < num_arenas; i++)
+    {
+        blocks[i] = mem_alloc(arena_size);
+        my_assert(blocks[i] != NULL);
+    }
+    for (size_t i = 0; i < num_arenas; i++)
+        mem_free(blocks[i]);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Threads allocate objects from a shared slab, fill them with their own pattern
+ * and free them again. An object handed out twice would be overwritten by
+ * another thread and fail the sanity check.
+ */
+mem_slab_t *test_slab;
+
+void *thread_slab_alloc_free(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+    char **objects = malloc(data->num_blocks * sizeof(char *));
+
+    for (int i = 0; i < data->iterations; i++)
+    {
+        for (int j = 0; j < data->num_blocks; j++)
+        {
+            objects[j] = mem_slab_alloc(test_slab);
+            my_assert(objects[j] != NULL);
+            memset(objects[j], data->thread_id, data->block_size);
+        }
+        my_barrier_wait(&barrier);
+        for (int j = 0; j < data->num_blocks; j++)
+        {
+            sanityCheck(data->block_size, objects[j], data->thread_id);
+            mem_slab_free(test_slab, objects[j]);
+        }
+    }
+    free(objects);
+    return NULL;
+}
+
+void test_slab_multithread(TestParams params)
+{
+    printf_yellow("  Testing \"mem_slab_alloc and mem_slab_free\" (threads: %d, objects per thread: %d) ---> ", params.num_threads, params.num_blocks);
+
+    mem_init(params.memory_size);
+    test_slab = mem_slab_create(params.block_size);
+    my_assert(test_slab != NULL);
+    my_barrier_init(&barrier, params.num_threads);
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].thread_id = i;
+        params_t[i].num_blocks = params.num_blocks;
+        params_t[i].block_size = params.block_size;
+        params_t[i].iterations = params.iterations;
+        pthread_create(&threads[i], NULL, thread_slab_alloc_free, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    // All pages go back to the pool with the slab
+    mem_slab_destroy(test_slab);
+    void *all = mem_alloc(params.memory_size);
+    my_assert(all != NULL);
+    mem_free(all);
+
+    my_barrier_destroy(&barrier);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Every thread fills a private pool to capacity while also churning blocks in
+ * a pool shared with the other threads (with thread caches) and the default
+ * pool holds a full-size block. Each pool must be sized and managed
+ * independently of the others.
+ */
+mem_pool_t *shared_pool;
+
+void *thread_private_pool(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+
+    mem_pool_t *pool = mem_pool_create(&(mem_config_t){.size = data->block_size});
+    my_assert(pool != NULL);
+
+    char *block = mem_pool_alloc(pool, data->block_size);
+    my_assert(block != NULL);
+    memset(block, data->thread_id, data->block_size);
+    my_assert(mem_pool_alloc(pool, 1) == NULL); // Full, whatever the other pools hold
+
+    for (int i = 0; i < data->iterations; i++)
+    {
+        char *shared = mem_pool_alloc(shared_pool, 64);
+        my_assert(shared != NULL);
+        memset(shared, data->thread_id, 64);
+        shared = mem_pool_resize(shared_pool, shared, 128);
+        my_assert(shared != NULL);
+        sanityCheck(64, shared, data->thread_id);
+        mem_pool_free(shared_pool, shared);
+    }
+
+    my_barrier_wait(&barrier);
+    sanityCheck(data->block_size, block, data->thread_id);
+
+    mem_pool_free(pool, block);
+    block = mem_pool_alloc(pool, data->block_size);
+    my_assert(block != NULL);
+    mem_pool_free(pool, block);
+    mem_pool_destroy(pool);
+    return NULL;
+}
+
+void test_pools_isolated(TestParams params)
+{
+    printf_yellow("  Testing \"independent pools\" (threads: %d) ---> ", params.num_threads);
+
+    mem_init(params.memory_size);
+    char *default_block = mem_alloc(params.memory_size);
+    my_assert(default_block != NULL);
+    memset(default_block, 0x5A, params.memory_size);
+
+    shared_pool = mem_pool_create(&(mem_config_t){.size = params.num_threads * 4096, .backend = MEM_BACKEND_TAGS, .tcache_count = 8});
+    my_assert(shared_pool != NULL);
+    my_barrier_init(&barrier, params.num_threads);
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].thread_id = i;
+        params_t[i].block_size = params.memory_size;
+        params_t[i].iterations = params.iterations;
+        pthread_create(&threads[i], NULL, thread_private_pool, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    // The threads' caches were flushed on exit and merged back into one free block
+    void *all = mem_pool_alloc(shared_pool, params.num_threads * 4096 - 1024);
+    my_assert(all != NULL);
+    mem_pool_free(shared_pool, all);
+    mem_pool_destroy(shared_pool);
+
+    sanityCheck(params.memory_size, default_block, 0x5A);
+    mem_free(default_block);
+    mem_deinit();
+
+    my_barrier_destroy(&barrier);
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Interleaves small unaligned requests with mem_alloc_aligned at alignments
+ * from 16 to 512 bytes, checks every address and that no block overlaps
+ * another, and then frees everything.
+ */
+void test_aligned_alloc(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"mem_alloc_aligned\" (%s) ---> ", config_name);
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .backend = params.backend, .tcache_count = params.tcache_count, .arenas = params.arenas});
+
+    char *blocks[32];
+    size_t sizes[32];
+    for (int i = 0; i < 16; i++)
+    {
+        size_t align = (size_t)16 << (i % 6);
+        sizes[2 * i] = 3 + i;
+        blocks[2 * i] = mem_alloc(sizes[2 * i]);
+        sizes[2 * i + 1] = 40 + i * 8;
+        blocks[2 * i + 1] = mem_alloc_aligned(sizes[2 * i + 1], align);
+        my_assert(blocks[2 * i] != NULL && blocks[2 * i + 1] != NULL);
+        my_assert((uintptr_t)blocks[2 * i + 1] % align == 0);
+        memset(blocks[2 * i], 2 * i, sizes[2 * i]);
+        memset(blocks[2 * i + 1], 2 * i + 1, sizes[2 * i + 1]);
+    }
+    my_assert(mem_alloc_aligned(16, 24) == NULL); // Not a power of two
+
+    for (int i = 0; i < 32; i++)
+    {
+        sanityCheck(sizes[i], blocks[i], i);
+        mem_free(blocks[i]);
+    }
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * With a default alignment configured, back-to-back odd-sized requests must
+ * all come out aligned, and so must the blocks mem_resize moves to.
+ */
+void test_default_alignment(TestParams params, size_t alignment, char *config_name)
+{
+    printf_yellow("  Testing \"default alignment of %zu\" (%s) ---> ", alignment, config_name);
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .backend = params.backend, .tcache_count = params.tcache_count, .alignment = alignment});
+
+    char *blocks[16];
+    for (int i = 0; i < 16; i++)
+    {
+        blocks[i] = mem_alloc(i % 2 ? 8 : 3);
+        my_assert(blocks[i] != NULL);
+        my_assert((uintptr_t)blocks[i] % alignment == 0);
+        memset(blocks[i], i, i % 2 ? 8 : 3);
+    }
+    for (int i = 0; i < 16; i += 2)
+    {
+        blocks[i] = mem_resize(blocks[i], 300);
+        my_assert(blocks[i] != NULL);
+        my_assert((uintptr_t)blocks[i] % alignment == 0);
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        sanityCheck(i % 2 ? 8 : 3, blocks[i], i);
+        mem_free(blocks[i]);
+    }
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * A pool set up with plain mem_init aligns to 16 bytes: an 8-byte block
+ * placed right after a 3-byte one must not start at an odd address.
+ */
+void test_mem_init_alignment()
+{
+    printf_yellow("  Testing \"default alignment of mem_init\" ---> ");
+    mem_init(1024);
+
+    char *small = mem_alloc(3);
+    long *word = mem_alloc(8);
+    my_assert(small != NULL && word != NULL);
+    my_assert((uintptr_t)small % 16 == 0);
+    my_assert((uintptr_t)word % 16 == 0);
+    *word = -1;
+    memset(small, 3, 3);
+    my_assert(*word == -1);
+
+    mem_free(small);
+    mem_free(word);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * With thread caches every block carries a header in front of its payload, so
+ * even a backend that packs blocks back to back must hand out 16-byte aligned
+ * blocks, for cached sizes and for those above tcache_max_size alike.
+ */
+void test_tcache_alignment(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"thread cache alignment\" (%s) ---> ", config_name);
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .backend = params.backend, .tcache_count = params.tcache_count});
+
+    size_t sizes[] = {3, 300, 8, 1000, 17, 2001};
+    char *blocks[6];
+    for (int i = 0; i < 6; i++)
+    {
+        blocks[i] = mem_alloc(sizes[i]);
+        my_assert(blocks[i] != NULL);
+        my_assert((uintptr_t)blocks[i] % 16 == 0);
+        memset(blocks[i], i, sizes[i]);
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        sanityCheck(sizes[i], blocks[i], i);
+        mem_free(blocks[i]);
+    }
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Growing a block whose neighbour is free must not move it, shrinking it must
+ * not move it either, and the space given up by shrinking must be reusable.
+ */
+void test_resize_in_place(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"mem_resize in place\" (%s) ---> ", config_name);
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .backend = params.backend, .tcache_count = params.tcache_count});
+
+    char *block = mem_alloc(100);
+    char *neighbour = mem_alloc(300);
+    my_assert(block != NULL && neighbour != NULL);
+    memset(block, 1, 100);
+    mem_free(neighbour);
+
+    char *grown = mem_resize(block, 1000);
+    my_assert(grown == block);
+    sanityCheck(100, grown, 1);
+    memset(grown, 2, 1000);
+
+    char *shrunk = mem_resize(grown, 50);
+    my_assert(shrunk == block);
+    sanityCheck(50, shrunk, 2);
+
+    // The tail went back to the pool and merged with the free space after it
+    void *large = mem_alloc(16 * 1024);
+    my_assert(large != NULL);
+    mem_free(large);
+
+    mem_free(shrunk);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * A pool mapped with mmap starts on a 2 MiB boundary (the first block of the
+ * list backend is the pool start) and is fully usable, whichever way its
+ * pages are backed. MEM_MAP_HUGETLB falls back when no huge pages are reserved.
+ */
+void test_mapped_pool(unsigned int map_flags, char *config_name)
+{
+    printf_yellow("  Testing \"mmap-backed pool\" (%s) ---> ", config_name);
+    size_t size = 3 * 1024 * 1024;
+    mem_init_ex(&(mem_config_t){.size = size, .map_flags = map_flags});
+
+    char *all = mem_alloc(size);
+    my_assert(all != NULL);
+    my_assert((uintptr_t)all % (2 * 1024 * 1024) == 0);
+    memset(all, 0x3C, size);
+    sanityCheck(size, all, 0x3C);
+    mem_free(all);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Threads allocate far more than the initial pool holds from a pool allowed to
+ * grow. Every block must stay where it is while the pool grows around it, a
+ * block resized across chunks keeps its contents, and requests beyond the
+ * growth cap fail.
+ */
+void *thread_grow_pool(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+
+    for (int i = 0; i < data->num_blocks; i++)
+    {
+        data->block_pointers[i] = mem_alloc(data->block_size);
+        my_assert(data->block_pointers[i] != NULL);
+        memset(data->block_pointers[i], data->thread_id, data->block_size);
+    }
+    my_barrier_wait(&barrier);
+
+    for (int i = 0; i < data->num_blocks; i++)
+        sanityCheck(data->block_size, data->block_pointers[i], data->thread_id);
+
+    char *resized = mem_resize(data->block_pointers[0], 8 * data->block_size);
+    my_assert(resized != NULL);
+    sanityCheck(data->block_size, resized, data->thread_id);
+    data->block_pointers[0] = resized;
+
+    for (int i = 0; i < data->num_blocks; i++)
+        mem_free(data->block_pointers[i]);
+    return NULL;
+}
+
+void test_growable_pool(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"growable pool\" (%s, threads: %d) ---> ", config_name, params.num_threads);
+    size_t max_size = 1024 * 1024;
+    mem_init_ex(&(mem_config_t){.size = params.memory_size, .backend = params.backend, .tcache_count = params.tcache_count, .max_size = max_size});
+    my_barrier_init(&barrier, params.num_threads);
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].thread_id = i;
+        params_t[i].num_blocks = params.num_blocks;
+        params_t[i].block_size = params.block_size;
+        params_t[i].block_pointers = malloc(params.num_blocks * sizeof(void *));
+        pthread_create(&threads[i], NULL, thread_grow_pool, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        free(params_t[i].block_pointers);
+    }
+
+    my_assert(mem_alloc(max_size) == NULL);
+    void *block = mem_alloc(params.block_size);
+    my_assert(block != NULL);
+    mem_free(block);
+
+    my_barrier_destroy(&barrier);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * A large block that is written and freed again must give its pages back to
+ * the OS, automatically with a purge threshold or on mem_trim otherwise, and
+ * the same memory must be usable again afterwards. Pages dropped with
+ * MADV_FREE stay resident until the OS needs them, so only the reported
+ * count is checked then.
+ */
+size_t resident_pages(char *start, size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pages = size / page;
+    unsigned char *vec = malloc(pages);
+    my_assert(mincore(start, size, vec) == 0);
+    size_t resident = 0;
+    for (size_t i = 0; i < pages; i++)
+        resident += vec[i] & 1;
+    free(vec);
+    return resident;
+}
+
+void test_return_to_os(TestParams params, size_t purge_threshold, mem_purge_mode_t purge_mode, char *config_name)
+{
+    printf_yellow("  Testing \"returning free memory to the OS\" (%s) ---> ", config_name);
+    size_t size = 4 * 1024 * 1024;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    mem_init_ex(&(mem_config_t){.size = 2 * size, .backend = params.backend, .tcache_count = params.tcache_count, .map_flags = MEM_MAP_ANONYMOUS, .purge_threshold = purge_threshold, .purge_mode = purge_mode});
+
+    char *block = mem_alloc(size);
+    my_assert(block != NULL);
+    memset(block, 0x5A, size);
+    char *pages = (char *)(((uintptr_t)block + page - 1) & ~(uintptr_t)(page - 1));
+    size_t span = size - page;
+    my_assert(resident_pages(pages, span) == span / page);
+
+    mem_free(block);
+    if (!purge_threshold)
+        my_assert(mem_trim() >= span - page);
+    if (purge_mode == MEM_PURGE_DONTNEED)
+        my_assert(resident_pages(pages, span) <= 1);
+
+    block = mem_alloc(size);
+    my_assert(block != NULL);
+    memset(block, 0x6B, size);
+    sanityCheck(size, block, 0x6B);
+    mem_free(block);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * A batch of equal-sized blocks is carved out of one free block back to back,
+ * passing over a hole that would fit its first block, and,
+ * freed in shuffled order, merges back into the whole pool even with the list
+ * backend's forward-only merging. A batch larger than the pool is cut short.
+ * Then threads allocate, fill, check and free batches side by side.
+ */
+void *thread_batch_alloc_free(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+
+    for (int i = 0; i < data->iterations; i++)
+    {
+        my_assert(mem_alloc_batch(data->block_size, data->num_blocks, data->block_pointers) == (size_t)data->num_blocks);
+        for (int j = 0; j < data->num_blocks; j++)
+            memset(data->block_pointers[j], data->thread_id, data->block_size);
+        my_barrier_wait(&barrier);
+        for (int j = 0; j < data->num_blocks; j++)
+            sanityCheck(data->block_size, data->block_pointers[j], data->thread_id);
+        mem_free_batch(data->block_pointers, data->num_blocks);
+    }
+    return NULL;
+}
+
+void test_batch_alloc_free(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"mem_alloc_batch and mem_free_batch\" (%s, threads: %d) ---> ", config_name, params.num_threads);
+    mem_init_ex(&(mem_config_t){.size = params.memory_size, .backend = params.backend, .tcache_count = params.tcache_count, .arenas = params.arenas});
+
+    void *hole = mem_alloc(params.block_size);
+    void *wall = mem_alloc(params.block_size);
+    my_assert(hole != NULL && wall != NULL);
+    mem_free(hole);
+
+    void **blocks = malloc(params.num_blocks * sizeof(void *));
+    my_assert(mem_alloc_batch(params.block_size, params.num_blocks, blocks) == (size_t)params.num_blocks);
+    if (!params.arenas) // Split into arenas, the pool has no free block that large
+    {
+        size_t stride = (char *)blocks[1] - (char *)blocks[0];
+        my_assert(blocks[0] != hole && stride >= params.block_size && stride < 2 * params.block_size);
+        for (int i = 1; i < params.num_blocks; i++)
+            my_assert((char *)blocks[i] == (char *)blocks[i - 1] + stride);
+    }
+    unsigned int seed = 5;
+    for (int i = params.num_blocks - 1; i > 0; i--)
+    {
+        int j = rand_r(&seed) % (i + 1);
+        void *tmp = blocks[i];
+        blocks[i] = blocks[j];
+        blocks[j] = tmp;
+    }
+    mem_free_batch(blocks, params.num_blocks);
+    mem_free(wall);
+    if (!params.tcache_count && !params.arenas)
+    {
+        mem_stats_t stats;
+        mem_stats(&stats);
+        my_assert(stats.free_blocks == 1);
+        // TLSF rounds a request this large up to the next of its size slices
+        void *all = mem_alloc(params.memory_size - (params.backend == MEM_BACKEND_TLSF ? 4096 : 1024)); // Room for in-pool metadata
+        my_assert(all != NULL);
+        mem_free(all);
+    }
+
+    size_t count = mem_alloc_batch(params.memory_size / 4, 8, blocks);
+    my_assert(count > 0 && count < 8);
+    mem_free_batch(blocks, count);
+    free(blocks);
+
+    my_barrier_init(&barrier, params.num_threads);
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].thread_id = i;
+        params_t[i].num_blocks = params.num_blocks / params.num_threads;
+        params_t[i].block_size = params.block_size;
+        params_t[i].iterations = params.iterations;
+        params_t[i].block_pointers = malloc(params_t[i].num_blocks * sizeof(void *));
+        pthread_create(&threads[i], NULL, thread_batch_alloc_free, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        free(params_t[i].block_pointers);
+    }
+    my_barrier_destroy(&barrier);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * Threads each fill a region of their own with objects of varying size, check
+ * them after all threads are done and release the region. Objects must be
+ * aligned and must not overlap, across regions or within one. Once all
+ * regions are released the pool must be whole again, and a region that runs
+ * the pool dry must fail cleanly.
+ */
+void *thread_region(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+
+    for (int i = 0; i < data->iterations; i++)
+    {
+        mem_region_t *region = mem_region_begin();
+        my_assert(region != NULL);
+        for (int j = 0; j < data->num_blocks; j++)
+        {
+            size_t size = 1 + (size_t)(j * 37) % data->max_block_size;
+            data->block_pointers[j] = mem_region_alloc(region, size);
+            my_assert(data->block_pointers[j] != NULL);
+            my_assert((uintptr_t)data->block_pointers[j] % 16 == 0);
+            memset(data->block_pointers[j], data->thread_id, size);
+        }
+        my_barrier_wait(&barrier);
+        for (int j = 0; j < data->num_blocks; j++)
+            sanityCheck(1 + (size_t)(j * 37) % data->max_block_size, data->block_pointers[j], data->thread_id);
+        mem_region_release(region);
+    }
+    return NULL;
+}
+
+void test_region_multithread(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"mem_region_alloc and mem_region_release\" (%s, threads: %d) ---> ", config_name, params.num_threads);
+    mem_init_ex(&(mem_config_t){.size = params.memory_size, .backend = params.backend, .tcache_count = params.tcache_count});
+
+    my_barrier_init(&barrier, params.num_threads);
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].thread_id = i;
+        params_t[i].num_blocks = params.num_blocks;
+        params_t[i].max_block_size = params.block_size;
+        params_t[i].iterations = params.iterations;
+        params_t[i].block_pointers = malloc(params.num_blocks * sizeof(void *));
+        pthread_create(&threads[i], NULL, thread_region, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        free(params_t[i].block_pointers);
+    }
+    my_barrier_destroy(&barrier);
+
+    if (!params.tcache_count)
+    {
+        // TLSF rounds a request this large up by as much as 1/16
+        void *all = mem_alloc(params.memory_size / 8 * 7);
+        my_assert(all != NULL);
+        mem_free(all);
+    }
+
+    mem_region_t *region = mem_region_begin();
+    my_assert(region != NULL);
+    my_assert(mem_region_alloc(region, params.memory_size) == NULL);
+    size_t allocated = 0;
+    while (mem_region_alloc(region, 1000) != NULL)
+        allocated += 1000;
+    my_assert(allocated > params.memory_size / 2);
+    mem_region_release(region);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+/*
+ * mem_stats must track every operation and the pool's occupancy as blocks
+ * are allocated, resized and freed, from one thread and from several.
+ */
+void *thread_stats_churn(void *arg)
+{
+    thread_data_t *data = (thread_data_t *)arg;
+
+    for (int i = 0; i < data->iterations; i++)
+    {
+        void *block = mem_alloc(data->block_size);
+        my_assert(block != NULL);
+        mem_free(block);
+    }
+    return NULL;
+}
+
+void test_stats(TestParams params, char *config_name)
+{
+    printf_yellow("  Testing \"mem_stats\" (%s) ---> ", config_name);
+    size_t size = 64 * 1024;
+    mem_init_ex(&(mem_config_t){.size = size, .backend = params.backend, .tcache_count = params.tcache_count});
+
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(stats.pool_size == size);
+    my_assert(stats.bytes_in_use == 0 && stats.blocks_in_use == 0);
+    my_assert(stats.free_blocks == 1 && stats.fragmentation == 0);
+    my_assert(stats.largest_free_block == stats.bytes_free && stats.bytes_free <= size);
+
+    void *blocks[10];
+    for (int i = 0; i < 10; i++)
+        blocks[i] = mem_alloc(100);
+    mem_stats(&stats);
+    my_assert(stats.allocs == 10 && stats.frees == 0);
+    my_assert(stats.bytes_in_use >= 1000);
+    if (!params.tcache_count)
+        my_assert(stats.blocks_in_use == 10); // Thread caches take blocks in batches
+    my_assert(stats.bytes_in_use + stats.bytes_free <= size);
+    size_t peak = stats.bytes_in_use;
+
+    for (int i = 1; i < 10; i += 2)
+        mem_free(blocks[i]);
+    blocks[0] = mem_resize(blocks[0], 50);
+    my_assert(mem_alloc(2 * size) == NULL);
+    mem_stats(&stats);
+    my_assert(stats.frees == 5 && stats.resizes == 1 && stats.failed_allocs == 1);
+    my_assert(stats.peak_bytes_in_use >= peak && stats.bytes_in_use < peak);
+    if (!params.tcache_count)
+    {
+        my_assert(stats.blocks_in_use == 5 && stats.free_blocks > 1);
+        my_assert(stats.fragmentation > 0 && stats.largest_free_block < stats.bytes_free);
+    }
+
+    // Last to first, so that the list backend merges them all too
+    for (int i = 8; i >= 0; i -= 2)
+        mem_free(blocks[i]);
+    mem_stats(&stats);
+    if (!params.tcache_count)
+    {
+        my_assert(stats.bytes_in_use == 0 && stats.blocks_in_use == 0);
+        my_assert(stats.free_blocks == 1 && stats.fragmentation == 0);
+    }
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].block_size = 64;
+        params_t[i].iterations = params.iterations;
+        pthread_create(&threads[i], NULL, thread_stats_churn, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+        pthread_join(threads[i], NULL);
+    mem_stats(&stats);
+    my_assert(stats.allocs == 10 + (uint64_t)params.num_threads * params.iterations);
+    my_assert(stats.frees == 10 + (uint64_t)params.num_threads * params.iterations);
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_lock_stats(TestParams params)
+{
+    printf_yellow("  Testing \"mem_lock_stats\" (threads: %d) ---> ", params.num_threads);
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .arenas = 2});
+
+    void *block = mem_alloc(100);
+    block = mem_resize(block, 200);
+    mem_free(block);
+    mem_stats_t stats;
+    mem_stats(&stats);
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].block_size = 64;
+        params_t[i].iterations = params.iterations;
+        pthread_create(&threads[i], NULL, thread_stats_churn, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    mem_lock_stats_t lock_stats[MEM_LOCK_OPS];
+    uint64_t ops = 1 + (uint64_t)params.num_threads * params.iterations;
+    if (mem_lock_stats(lock_stats) == 0)
+    {
+        my_assert(lock_stats[MEM_LOCK_ALLOC].acquires >= ops);
+        my_assert(lock_stats[MEM_LOCK_FREE].acquires >= ops);
+        my_assert(lock_stats[MEM_LOCK_RESIZE].acquires >= 1);
+        my_assert(lock_stats[MEM_LOCK_OTHER].acquires >= 1);
+        for (int op = 0; op < MEM_LOCK_OPS; op++)
+        {
+            my_assert(lock_stats[op].contended <= lock_stats[op].acquires);
+            my_assert(lock_stats[op].max_wait_ns <= lock_stats[op].wait_ns);
+            my_assert(lock_stats[op].max_hold_ns <= lock_stats[op].hold_ns);
+        }
+    }
+    else
+    {
+        // Compiled out: nothing is counted
+        for (int op = 0; op < MEM_LOCK_OPS; op++)
+            my_assert(lock_stats[op].acquires == 0 && lock_stats[op].hold_ns == 0);
+    }
+
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_latency_histograms(TestParams params, mem_latency_clock_t clock, char *config_name)
+{
+    printf_yellow("  Testing \"latency histograms\" (%s) ---> ", config_name);
+    static mem_histogram_t hist, merged;
+
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .tcache_count = params.tcache_count});
+    my_assert(mem_latency_snapshot(&hist) == -1);
+    my_assert(mem_histogram_count(&hist, MEM_OP_ALLOC, -1) == 0);
+    mem_deinit();
+
+    mem_init_ex(&(mem_config_t){.size = 64 * 1024, .tcache_count = params.tcache_count, .latency_clock = clock});
+    void *small = mem_alloc(10);
+    void *large = mem_alloc(5000);
+    large = mem_resize(large, 6000);
+    mem_free(small);
+    mem_free(large);
+    my_assert(mem_latency_snapshot(&hist) == 0);
+    my_assert(mem_histogram_count(&hist, MEM_OP_ALLOC, -1) == 2);
+    my_assert(mem_histogram_count(&hist, MEM_OP_ALLOC, 0) == 1);  // Up to 16 bytes
+    my_assert(mem_histogram_count(&hist, MEM_OP_ALLOC, 9) == 1);  // Up to 8 KiB
+    my_assert(mem_histogram_count(&hist, MEM_OP_RESIZE, 9) == 1);
+    my_assert(mem_histogram_count(&hist, MEM_OP_FREE, -1) == 2);
+    my_assert(mem_histogram_count(&hist, MEM_OP_FREE, 0) == 1);
+    my_assert(mem_histogram_count(&hist, MEM_OP_FREE, 9) == 1);
+
+    pthread_t threads[params.num_threads];
+    thread_data_t params_t[params.num_threads];
+    for (int i = 0; i < params.num_threads; i++)
+    {
+        params_t[i].block_size = 64;
+        params_t[i].iterations = params.iterations;
+        pthread_create(&threads[i], NULL, thread_stats_churn, &params_t[i]);
+    }
+    for (int i = 0; i < params.num_threads; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t churned = (uint64_t)params.num_threads * params.iterations;
+    my_assert(mem_latency_snapshot(&hist) == 0);
+    my_assert(mem_histogram_count(&hist, MEM_OP_ALLOC, 2) == churned); // Up to 64 bytes
+    my_assert(mem_histogram_count(&hist, MEM_OP_FREE, 2) == churned);
+    uint64_t p50 = mem_histogram_percentile(&hist, MEM_OP_ALLOC, 2, 50);
+    uint64_t p99 = mem_histogram_percentile(&hist, MEM_OP_ALLOC, 2, 99);
+    uint64_t max = mem_histogram_percentile(&hist, MEM_OP_ALLOC, 2, 100);
+    my_assert(p50 <= p99 && p99 <= max && max > 0);
+
+    memset(&merged, 0, sizeof(merged));
+    mem_histogram_merge(&merged, &hist);
+    mem_histogram_merge(&merged, &hist);
+    my_assert(mem_histogram_count(&merged, MEM_OP_FREE, -1) == 2 * (churned + 2));
+    my_assert(mem_histogram_percentile(&merged, MEM_OP_ALLOC, 2, 99) == p99);
+
+    mem_latency_reset();
+    mem_latency_snapshot(&hist);
+    for (int op = 0; op < MEM_OPS; op++)
+        my_assert(mem_histogram_count(&hist, op, -1) == 0);
+
+    // The free reports its block's size itself, under the one lock it takes
+    static mem_lock_stats_t before[MEM_LOCK_OPS], after[MEM_LOCK_OPS];
+    void *block = mem_alloc(100);
+    int lock_stats = mem_lock_stats(before);
+    mem_free(block);
+    if (lock_stats == 0)
+    {
+        mem_lock_stats(after);
+        my_assert(after[MEM_LOCK_FREE].acquires <= before[MEM_LOCK_FREE].acquires + 1);
+        my_assert(after[MEM_LOCK_OTHER].acquires == before[MEM_LOCK_OTHER].acquires);
+    }
+    mem_latency_snapshot(&hist);
+    my_assert(mem_histogram_count(&hist, MEM_OP_FREE, 3) == 1); // Up to 128 bytes
+    mem_deinit();
+
+    // Buckets are exact below 8 ns, then 8 to a power of two
+    memset(&hist, 0, sizeof(hist));
+    hist.counts[MEM_OP_ALLOC][0][5] = 1;
+    hist.counts[MEM_OP_ALLOC][3][8] = 2;    // 8 ns
+    hist.counts[MEM_OP_ALLOC][3][17] = 1;   // 18 or 19 ns
+    my_assert(mem_histogram_percentile(&hist, MEM_OP_ALLOC, -1, 0) == 5);
+    my_assert(mem_histogram_percentile(&hist, MEM_OP_ALLOC, -1, 25) == 5);
+    my_assert(mem_histogram_percentile(&hist, MEM_OP_ALLOC, -1, 50) == 8);
+    my_assert(mem_histogram_percentile(&hist, MEM_OP_ALLOC, -1, 99.9) == 19);
+    my_assert(mem_histogram_percentile(&hist, MEM_OP_ALLOC, 3, 50) == 8);
+    my_assert(mem_histogram_percentile(&hist, MEM_OP_FREE, -1, 50) == 0);
+
+    printf_green("[PASS].\n");
+}
+
+typedef struct
+{
+    size_t used_bytes, used_blocks, free_bytes, free_blocks;
+    int last_arena;
+    size_t next_offset; // Where the next block of the same arena has to start
+    int gaps;           // Blocks of one arena that do not follow each other
+} walk_totals_t;
+
+static void count_block(const mem_block_info_t *block, void *ctx)
+{
+    walk_totals_t *totals = (walk_totals_t *)ctx;
+    if (block->arena == totals->last_arena && block->offset != totals->next_offset)
+        totals->gaps++;
+    totals->last_arena = block->arena;
+    totals->next_offset = block->offset + block->size;
+    if (block->is_free)
+    {
+        totals->free_bytes += block->size;
+        totals->free_blocks++;
+    }
+    else
+    {
+        totals->used_bytes += block->size;
+        totals->used_blocks++;
+    }
+}
+
+void test_heap_walk(mem_backend_t backend, size_t arenas, char *config_name)
+{
+    printf_yellow("  Testing \"mem_walk and mem_dump\" (%s) ---> ", config_name);
+    mem_init_ex(&(mem_config_t){.size = 256 * 1024, .backend = backend, .arenas = arenas, .max_size = 1024 * 1024});
+
+    void *blocks[64];
+    for (int i = 0; i < 64; i++)
+        blocks[i] = mem_alloc(16 + 40 * i);
+    for (int i = 0; i < 64; i += 3)
+        mem_free(blocks[i]);
+    void *big = mem_alloc(200 * 1024); // Does not fit next to the others: a chunk
+    my_assert(big != NULL);
+
+    walk_totals_t totals = {.last_arena = -1};
+    my_assert(mem_walk(count_block, &totals) == 0);
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(totals.gaps == 0);
+    my_assert(totals.used_blocks == stats.blocks_in_use && totals.free_blocks == stats.free_blocks);
+    my_assert(totals.used_bytes == stats.bytes_in_use && totals.free_bytes == stats.bytes_free);
+    my_assert(totals.used_blocks == 64 - 22 + 1);
+
+    char path[] = "/tmp/mem_dump_XXXXXX";
+    int fd = mkstemp(path);
+    my_assert(fd >= 0);
+    close(fd);
+    my_assert(mem_dump(path) == 0);
+    FILE *in = fopen(path, "r");
+    char line[256];
+    size_t lines = 0, used = 0;
+    my_assert(fgets(line, sizeof(line), in) && line[0] == '#');
+    my_assert(fgets(line, sizeof(line), in) && strcmp(line, "arena,offset,size,state\n") == 0);
+    while (fgets(line, sizeof(line), in))
+    {
+        lines++;
+        used += strstr(line, ",used") != NULL;
+    }
+    fclose(in);
+    unlink(path);
+    my_assert(lines == totals.used_blocks + totals.free_blocks && used == totals.used_blocks);
+
+    mem_deinit();
+    my_assert(mem_walk(count_block, &totals) == -1);
+    printf_green("[PASS].\n");
+}
+
+typedef struct
+{
+    size_t next; // Offset of the next node, 0 at the end
+    int value;
+} file_node_t;
+
+void test_file_pool()
+{
+    printf_yellow("  Testing \"file-backed pool\" ---> ");
+    char path[] = "/tmp/mem_pool_XXXXXX";
+    int fd = mkstemp(path);
+    my_assert(fd >= 0);
+    close(fd);
+
+    // A new pool: build a list linked by offsets and name its head
+    my_assert(mem_init_file(path, 64 * 1024) == MEM_FILE_CREATED);
+    int status = 0;
+    my_assert(mem_pool_create_file(path, 0, &status) == NULL && status == -1); // Locked while in use
+    size_t head = 0;
+    for (int i = 99; i >= 0; i--)
+    {
+        file_node_t *node = mem_alloc(sizeof(file_node_t));
+        my_assert(node != NULL);
+        node->value = i;
+        node->next = head;
+        head = mem_offset_of(node);
+    }
+    my_assert(mem_set_root("list", mem_ptr_at(head)) == 0);
+    my_assert(mem_set_root("a name much too long to fit into the root table of the file", mem_ptr_at(head)) == -1);
+    my_assert(mem_get_root("missing") == NULL);
+    mem_deinit();
+
+    // A clean restart finds the list as it was
+    my_assert((mem_init_file(path, 0) & ~MEM_FILE_MOVED) == MEM_FILE_ATTACHED);
+    int count = 0;
+    file_node_t *prev = NULL;
+    for (file_node_t *node = mem_get_root("list"); node; node = mem_ptr_at(node->next), count++)
+    {
+        my_assert(node->value == count);
+        if (count % 2 && prev)
+        {
+            prev->next = node->next; // Unlink and free every other node
+            mem_free(node);
+            node = prev;
+        }
+        prev = node;
+    }
+    my_assert(count == 100);
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(stats.pool_size == 64 * 1024 && stats.blocks_in_use == 50);
+    mem_deinit();
+
+    // Another process cannot open the file while this one has it
+    my_assert((mem_init_file(path, 0) & ~MEM_FILE_MOVED) == MEM_FILE_ATTACHED);
+    pid_t child = fork();
+    if (child == 0)
+        _exit(mem_pool_create_file(path, 0, NULL) == NULL ? 0 : 1);
+    int child_status;
+    waitpid(child, &child_status, 0);
+    my_assert(WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0);
+    mem_deinit();
+
+    // A process that dies without mem_deinit leaves the heap to be rebuilt
+    child = fork();
+    if (child == 0)
+    {
+        if (mem_init_file(path, 0) < 0)
+            _exit(1);
+        for (int i = 0; i < 10; i++)
+            mem_set_root("extra", mem_alloc(200));
+        mem_free(mem_get_root("extra"));
+        mem_set_root("extra", mem_alloc(300));
+        _exit(0);
+    }
+    waitpid(child, &child_status, 0);
+    my_assert(WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0);
+    my_assert((mem_init_file(path, 0) & ~MEM_FILE_MOVED) == MEM_FILE_RECOVERED);
+    my_assert(mem_get_root("extra") != NULL && mem_get_root("list") != NULL);
+    mem_stats(&stats);
+    my_assert(stats.blocks_in_use == 50 + 10);
+    walk_totals_t totals = {.last_arena = -1};
+    mem_walk(count_block, &totals);
+    my_assert(totals.gaps == 0 && totals.free_blocks == stats.free_blocks && totals.free_bytes == stats.bytes_free);
+    void *block = mem_alloc(1000);
+    my_assert(block != NULL);
+    mem_free(block);
+    mem_deinit();
+
+    // Files that do not hold a pool are left alone
+    FILE *out = fopen(path, "w");
+    fputs("not a memory pool", out);
+    fclose(out);
+    my_assert(mem_init_file(path, 64 * 1024) == -1);
+    unlink(path);
+
+    mem_init(4096);
+    my_assert(mem_set_root("list", mem_alloc(16)) == -1);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_shared_pool()
+{
+    printf_yellow("  Testing \"shared-memory pool\" ---> ");
+    const int children = 4, blocks = 100;
+
+    // Forked workers allocate side by side and leave their blocks in a root array
+    my_assert(mem_init_shared(NULL, 256 * 1024) == MEM_FILE_CREATED);
+    size_t *slots = mem_alloc(children * blocks * sizeof(size_t));
+    my_assert(slots != NULL && mem_set_root("slots", slots) == 0);
+    for (int c = 0; c < children; c++)
+    {
+        if (fork() == 0)
+        {
+            size_t *mine = (size_t *)mem_get_root("slots") + c * blocks;
+            for (int i = 0; i < blocks; i++)
+            {
+                int *block = mem_alloc(64);
+                if (!block)
+                    _exit(1);
+                *block = c * blocks + i;
+                mine[i] = mem_offset_of(block);
+            }
+            for (int i = 0; i < blocks; i += 2)
+                mem_free(mem_ptr_at(mine[i]));
+            _exit(0);
+        }
+    }
+    for (int c = 0; c < children; c++)
+    {
+        int child_status;
+        wait(&child_status);
+        my_assert(WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0);
+    }
+    for (int i = 1; i < children * blocks; i += 2)
+        my_assert(*(int *)mem_ptr_at(slots[i]) == i);
+    mem_stats_t stats;
+    mem_stats(&stats);
+    my_assert(stats.blocks_in_use == 1 + children * blocks / 2);
+
+    // Workers killed at random points, likely while holding the lock
+    for (int round = 0; round < 5; round++)
+    {
+        pid_t child = fork();
+        if (child == 0)
+        {
+            void *held[8] = {0};
+            for (unsigned int i = 0;; i++)
+            {
+                if (held[i % 8])
+                    mem_free(held[i % 8]);
+                held[i % 8] = mem_alloc(16 + i % 500);
+            }
+        }
+        usleep(20000);
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+    }
+    void *block = mem_alloc(1000);
+    my_assert(block != NULL);
+    mem_free(block);
+    mem_stats(&stats);
+    walk_totals_t totals = {.last_arena = -1};
+    my_assert(mem_walk(count_block, &totals) == 0);
+    my_assert(totals.gaps == 0);
+    my_assert(totals.used_blocks == stats.blocks_in_use && totals.free_blocks == stats.free_blocks);
+    my_assert(totals.free_bytes == stats.bytes_free);
+    mem_deinit();
+
+    // Two mappings of one named pool see the same blocks at different addresses
+    char name[64];
+    snprintf(name, sizeof(name), "/mem_test_%d", (int)getpid());
+    int status;
+    mem_pool_t *first = mem_pool_create_shared(name, 64 * 1024, &status);
+    my_assert(first != NULL && status == MEM_FILE_CREATED);
+    mem_pool_t *second = mem_pool_create_shared(name, 0, &status);
+    my_assert(second != NULL && status == MEM_FILE_ATTACHED);
+    char *text = mem_pool_alloc(first, 32);
+    strcpy(text, "shared");
+    my_assert(mem_pool_set_root(first, "text", text) == 0);
+    char *seen = mem_pool_get_root(second, "text");
+    my_assert(seen != text && strcmp(seen, "shared") == 0);
+    mem_pool_free(second, seen);
+    mem_pool_stats(first, &stats);
+    my_assert(stats.blocks_in_use == 0);
+    mem_pool_destroy(second);
+    mem_pool_destroy(first);
+    shm_unlink(name);
+
+    printf_green("[PASS].\n");
+}
+
 /* repeated from A1, as there were solutions that has issues */
 
 void test_looking_for_out_of_bounds()
@@ -922,6 +2367,7 @@ int main(int argc, char *argv[])
         printf("\n*** Testing various functions with a base number of threads: ***\n");
         run_concurrent_test(test_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 1024}, "mem_alloc and mem_free");
         run_concurrent_test(test_zero_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 1024}, "zero alloc and free");
+        test_zero_alloc_distinct();
 
         test_resize_multithread((TestParams){.num_threads = base_num_threads});
 
@@ -935,6 +2381,129 @@ int main(int argc, char *argv[])
 
         test_memory_fragmentation_multithread((TestParams){.num_threads = base_num_threads, .memory_size = 2048});
         test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024});
+        test_backend_coalescing(MEM_BACKEND_LIST, "list");
+        test_invalid_free(MEM_BACKEND_LIST, "list");
+
+        printf("\n*** Testing the boundary-tag backend: ***\n");
+        run_concurrent_test(test_zero_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 4096, .backend = MEM_BACKEND_TAGS}, "zero alloc and free");
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .backend = MEM_BACKEND_TAGS});
+        test_backend_coalescing(MEM_BACKEND_TAGS, "tags");
+        test_invalid_free(MEM_BACKEND_TAGS, "tags");
+
+        printf("\n*** Testing the buddy backend: ***\n");
+        run_concurrent_test(test_zero_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 4096, .backend = MEM_BACKEND_BUDDY}, "zero alloc and free");
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .backend = MEM_BACKEND_BUDDY});
+        test_backend_coalescing(MEM_BACKEND_BUDDY, "buddy");
+        test_invalid_free(MEM_BACKEND_BUDDY, "buddy");
+
+        printf("\n*** Testing the TLSF backend: ***\n");
+        run_concurrent_test(test_zero_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 4096, .backend = MEM_BACKEND_TLSF}, "zero alloc and free");
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .backend = MEM_BACKEND_TLSF});
+        test_backend_coalescing(MEM_BACKEND_TLSF, "TLSF");
+        test_invalid_free(MEM_BACKEND_TLSF, "TLSF");
+
+        printf("\n*** Testing placement policies: ***\n");
+        test_placement_policy(MEM_PLACE_CLASS_FIT, "class fit");
+        test_placement_policy(MEM_PLACE_FIRST_FIT, "first fit");
+        test_placement_policy(MEM_PLACE_NEXT_FIT, "next fit");
+        test_placement_policy(MEM_PLACE_BEST_FIT, "best fit");
+        test_best_fit_tree();
+        run_concurrent_test(test_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 1024, .placement = MEM_PLACE_NEXT_FIT}, "mem_alloc and mem_free, next fit");
+        run_concurrent_test(test_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 1024, .placement = MEM_PLACE_BEST_FIT}, "mem_alloc and mem_free, best fit");
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .placement = MEM_PLACE_NEXT_FIT});
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .placement = MEM_PLACE_BEST_FIT});
+
+        printf("\n*** Testing per-thread caches: ***\n");
+        run_concurrent_test(test_zero_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 4096, .tcache_count = 8}, "zero alloc and free");
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .tcache_count = 32});
+        test_thread_cache_multithread((TestParams){.num_threads = base_num_threads, .iterations = 100, .tcache_count = 32});
+        test_thread_cache_multithread((TestParams){.num_threads = base_num_threads, .iterations = 100, .tcache_count = 32, .backend = MEM_BACKEND_TAGS});
+
+        printf("\n*** Testing multiple arenas: ***\n");
+        run_concurrent_test(test_alloc_and_free, (TestParams){.num_threads = base_num_threads, .memory_size = 4096, .arenas = 4}, "mem_alloc and mem_free");
+        test_random_blocks_multithread((TestParams){.num_threads = base_num_threads, .block_size = 1024, .arenas = 4});
+        test_arena_cross_thread_free(4);
+        test_thread_cache_multithread((TestParams){.num_threads = base_num_threads, .iterations = 100, .tcache_count = 32, .arenas = 4});
+        run_concurrency_test((TestParams){.num_threads = 8, .num_blocks = 1 << 12, .block_size = 128, .arenas = 8});
+
+        printf("\n*** Testing the slab allocator: ***\n");
+        test_slab_multithread((TestParams){.num_threads = base_num_threads, .memory_size = 64 * 1024, .num_blocks = 256, .block_size = 16, .iterations = 10});
+        test_slab_multithread((TestParams){.num_threads = 16, .memory_size = 256 * 1024, .num_blocks = 100, .block_size = 40, .iterations = 10});
+
+        printf("\n*** Testing aligned allocation: ***\n");
+        test_aligned_alloc((TestParams){.backend = MEM_BACKEND_LIST}, "list");
+        test_aligned_alloc((TestParams){.backend = MEM_BACKEND_TAGS}, "tags");
+        test_aligned_alloc((TestParams){.backend = MEM_BACKEND_BUDDY}, "buddy");
+        test_aligned_alloc((TestParams){.backend = MEM_BACKEND_TLSF}, "TLSF");
+        test_aligned_alloc((TestParams){.backend = MEM_BACKEND_LIST, .tcache_count = 8}, "list, thread caches");
+        test_aligned_alloc((TestParams){.backend = MEM_BACKEND_LIST, .arenas = 4}, "list, 4 arenas");
+        test_default_alignment((TestParams){.backend = MEM_BACKEND_LIST}, 16, "list");
+        test_default_alignment((TestParams){.backend = MEM_BACKEND_TAGS}, 64, "tags");
+        test_default_alignment((TestParams){.backend = MEM_BACKEND_LIST, .tcache_count = 8}, 64, "list, thread caches");
+        test_mem_init_alignment();
+        test_tcache_alignment((TestParams){.backend = MEM_BACKEND_LIST, .tcache_count = 8}, "list, thread caches");
+
+        printf("\n*** Testing in-place resizing: ***\n");
+        test_resize_in_place((TestParams){.backend = MEM_BACKEND_LIST}, "list");
+        test_resize_in_place((TestParams){.backend = MEM_BACKEND_TAGS}, "tags");
+        test_resize_in_place((TestParams){.backend = MEM_BACKEND_BUDDY}, "buddy");
+        test_resize_in_place((TestParams){.backend = MEM_BACKEND_TLSF}, "TLSF");
+        test_resize_in_place((TestParams){.backend = MEM_BACKEND_LIST, .tcache_count = 8}, "list, thread caches");
+
+        printf("\n*** Testing mmap-backed pools: ***\n");
+        test_mapped_pool(MEM_MAP_ANONYMOUS, "anonymous");
+        test_mapped_pool(MEM_MAP_POPULATE, "populated");
+        test_mapped_pool(MEM_MAP_HUGEPAGE, "transparent huge pages");
+        test_mapped_pool(MEM_MAP_HUGEPAGE | MEM_MAP_POPULATE, "transparent huge pages, populated");
+        test_mapped_pool(MEM_MAP_HUGETLB | MEM_MAP_POPULATE, "hugetlb, populated");
+
+        printf("\n*** Testing growable pools: ***\n");
+        test_growable_pool((TestParams){.num_threads = base_num_threads, .memory_size = 4096, .num_blocks = 64, .block_size = 1000}, "list");
+        test_growable_pool((TestParams){.num_threads = base_num_threads, .memory_size = 4096, .num_blocks = 64, .block_size = 1000, .backend = MEM_BACKEND_TAGS}, "tags");
+        test_growable_pool((TestParams){.num_threads = base_num_threads, .memory_size = 4096, .num_blocks = 64, .block_size = 1000, .tcache_count = 8}, "list, thread caches");
+
+        printf("\n*** Testing returning free memory to the OS: ***\n");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_LIST}, 0, MEM_PURGE_DONTNEED, "list, mem_trim");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_TAGS}, 0, MEM_PURGE_DONTNEED, "tags, mem_trim");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_BUDDY}, 0, MEM_PURGE_DONTNEED, "buddy, mem_trim");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_TLSF}, 0, MEM_PURGE_DONTNEED, "TLSF, mem_trim");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_LIST, .tcache_count = 8}, 0, MEM_PURGE_DONTNEED, "list, thread caches, mem_trim");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_TAGS}, 64 * 1024, MEM_PURGE_DONTNEED, "tags, on free");
+        test_return_to_os((TestParams){.backend = MEM_BACKEND_LIST}, 0, MEM_PURGE_FREE, "list, MADV_FREE");
+
+        printf("\n*** Testing batch allocation: ***\n");
+        test_batch_alloc_free((TestParams){.num_threads = base_num_threads, .memory_size = 64 * 1024, .num_blocks = 256, .block_size = 64, .iterations = 10}, "list");
+        test_batch_alloc_free((TestParams){.num_threads = base_num_threads, .memory_size = 64 * 1024, .num_blocks = 256, .block_size = 64, .iterations = 10, .backend = MEM_BACKEND_TAGS}, "tags");
+        test_batch_alloc_free((TestParams){.num_threads = base_num_threads, .memory_size = 64 * 1024, .num_blocks = 256, .block_size = 64, .iterations = 10, .backend = MEM_BACKEND_TLSF}, "TLSF");
+        test_batch_alloc_free((TestParams){.num_threads = base_num_threads, .memory_size = 64 * 1024, .num_blocks = 256, .block_size = 64, .iterations = 10, .tcache_count = 8}, "list, thread caches");
+        test_batch_alloc_free((TestParams){.num_threads = base_num_threads, .memory_size = 64 * 1024, .num_blocks = 256, .block_size = 64, .iterations = 10, .arenas = 4}, "list, 4 arenas");
+
+        printf("\n*** Testing regions: ***\n");
+        test_region_multithread((TestParams){.num_threads = base_num_threads, .memory_size = 1024 * 1024, .num_blocks = 1000, .block_size = 200, .iterations = 5, .backend = MEM_BACKEND_TAGS}, "tags");
+        test_region_multithread((TestParams){.num_threads = 1, .memory_size = 1024 * 1024, .num_blocks = 1000, .block_size = 200, .iterations = 5}, "list");
+        test_region_multithread((TestParams){.num_threads = base_num_threads, .memory_size = 1024 * 1024, .num_blocks = 1000, .block_size = 200, .iterations = 5, .backend = MEM_BACKEND_TLSF}, "TLSF");
+        test_region_multithread((TestParams){.num_threads = base_num_threads, .memory_size = 1024 * 1024, .num_blocks = 1000, .block_size = 200, .iterations = 5, .tcache_count = 8}, "list, thread caches");
+
+        printf("\n*** Testing statistics: ***\n");
+        test_stats((TestParams){.num_threads = base_num_threads, .iterations = 1000, .backend = MEM_BACKEND_LIST}, "list");
+        test_stats((TestParams){.num_threads = base_num_threads, .iterations = 1000, .backend = MEM_BACKEND_TAGS}, "tags");
+        test_stats((TestParams){.num_threads = base_num_threads, .iterations = 1000, .backend = MEM_BACKEND_BUDDY}, "buddy");
+        test_stats((TestParams){.num_threads = base_num_threads, .iterations = 1000, .backend = MEM_BACKEND_TLSF}, "TLSF");
+        test_stats((TestParams){.num_threads = base_num_threads, .iterations = 1000, .tcache_count = 8}, "list, thread caches");
+        test_lock_stats((TestParams){.num_threads = base_num_threads, .iterations = 1000});
+        test_latency_histograms((TestParams){.num_threads = base_num_threads, .iterations = 1000}, MEM_CLOCK_MONOTONIC, "monotonic clock");
+        test_latency_histograms((TestParams){.num_threads = base_num_threads, .iterations = 1000}, MEM_CLOCK_TSC, "TSC");
+        test_latency_histograms((TestParams){.num_threads = base_num_threads, .iterations = 1000, .tcache_count = 8}, MEM_CLOCK_MONOTONIC, "thread caches");
+        test_heap_walk(MEM_BACKEND_LIST, 1, "list");
+        test_heap_walk(MEM_BACKEND_TAGS, 1, "tags");
+        test_heap_walk(MEM_BACKEND_BUDDY, 1, "buddy");
+        test_heap_walk(MEM_BACKEND_TLSF, 1, "TLSF");
+        test_heap_walk(MEM_BACKEND_LIST, 4, "list, 4 arenas");
+        test_file_pool();
+        test_shared_pool();
+
+        printf("\n*** Testing independent pools: ***\n");
+        test_pools_isolated((TestParams){.num_threads = base_num_threads, .memory_size = 1024, .iterations = 100});
 
         break;
 